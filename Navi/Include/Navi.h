@@ -47,7 +47,7 @@ namespace NaviLibrary
 		/**
 		* Loads a local file into the main frame.
 		*
-		* @note	The file should reside in the base directory.
+		* @note	The file should reside in the base directory, or in the resource cache (see NaviManager::preloadResources).
 		*/
 		void loadFile(const std::string& file);
 
@@ -154,6 +154,82 @@ namespace NaviLibrary
 		*/
 		void setMaxUPS(unsigned int maxUPS = 0);
 
+		/**
+		* Attaches this Navi to a node in the scene so that its update rate may be lowered as the LOD camera
+		* (see NaviManager::setLODCamera) moves away from it, or as it covers less of the screen. This is mostly
+		* useful for NaviMaterials applied to in-world surfaces.
+		*
+		* @param	anchor	The scene node the Navi is displayed on (the bounds of the objects attached to it are
+		*					used to estimate its projected coverage). Pass 0 to disable automatic LOD.
+		*/
+		void setLODAnchor(Ogre::SceneNode* anchor);
+
+		/**
+		* Defines how the update rate of this Navi falls off with distance from the LOD camera. (see Navi::setLODAnchor)
+		* The update rate is linearly reduced from its full rate (see Navi::setMaxUPS, 60 updates per second is used
+		* when no limit has been set) down to 'minUPS'.
+		*
+		* @param	fullRateDistance	Closer than this distance, the Navi updates at its full rate.
+		*
+		* @param	minRateDistance		Farther than this distance, the Navi updates at 'minUPS'.
+		*
+		* @param	minUPS		The number of times per second the Navi may update when far away. (Optional, default is 1)
+		*/
+		void setLODDistances(Ogre::Real fullRateDistance, Ogre::Real minRateDistance, unsigned int minUPS = 1);
+
+		/**
+		* Defines how the update rate of this Navi falls off as it covers less of the screen. (see Navi::getProjectedCoverage)
+		* Below 'fullRateCoverage', the update rate is reduced in proportion to the coverage, down to 'minUPS'. When
+		* distance-based LOD is also in use, the lower of the two update rates is used.
+		*
+		* @param	fullRateCoverage	The fraction of the viewport (0 to 1) this Navi must cover to update at its full rate.
+		*								Pass 0 to disable coverage-based LOD.
+		*
+		* @param	minUPS		The number of times per second the Navi may update when it barely covers the screen
+		*						or can't be seen at all. (Optional, default is 1)
+		*/
+		void setLODCoverage(Ogre::Real fullRateCoverage, unsigned int minUPS = 1);
+
+		/**
+		* Overrides the projected coverage of this Navi, for applications that already know how large their in-world
+		* surfaces appear on screen. (see Navi::setLODCoverage)
+		*
+		* @param	coverage	The fraction of the viewport (0 to 1) this Navi covers. Pass a negative value to go back to
+		*						estimating the coverage from the LOD anchor and camera (default).
+		*/
+		void setProjectedCoverage(Ogre::Real coverage);
+
+		/**
+		* Retrieves the fraction of the viewport (0 to 1) this Navi covers: either the value passed to
+		* Navi::setProjectedCoverage or an estimate from the bounds of the LOD anchor as seen by the LOD camera.
+		*
+		* @return	The projected coverage, or -1 if it is unknown (no LOD anchor or camera).
+		*/
+		Ogre::Real getProjectedCoverage() const;
+
+		/**
+		* Changes the internal resolution this Navi is rendered at, relative to the size it was created with. The
+		* page is rendered at the reduced size and stretched to fill the Navi, so rasterization and upload costs
+		* drop quadratically; this is well-suited to blurry background panels or distant NaviMaterials. To keep the
+		* layout of the page unchanged, every loaded page is zoomed by the same factor (CSS 'zoom' on the document
+		* element) before it is first shown. Mouse input is rescaled accordingly, all coordinates passed to and
+		* retrieved from this Navi remain in its original (unscaled) coordinate space.
+		*
+		* @param	resolutionScale		The internal resolution as a fraction of the Navi's size (0.1 to 1, default is 1).
+		*
+		* @note	Changing the resolution re-creates the underlying WebView: the current page is reloaded and all
+		*		callbacks and properties are restored, but any other page state (form input, state set via
+		*		Navi::evaluateJS) is lost. Settings of the Navi itself (transparency, mask, images) are kept.
+		*
+		* @note	CSS media queries still see the reduced viewport size, pages that depend on them may lay out differently.
+		*/
+		void setResolutionScale(float resolutionScale);
+
+		/**
+		* Retrieves the internal resolution of this Navi, relative to its size. (see Navi::setResolutionScale)
+		*/
+		float getResolutionScale();
+
 		/**
 		* Toggles whether or not this Navi is movable. (not applicable to NaviMaterials)
 		*
@@ -169,6 +245,44 @@ namespace NaviLibrary
 		*/
 		void setOpacity(float opacity);
 
+		/**
+		* Animates the overall opacity of this Navi to a certain percentage.
+		*
+		* @param	opacity		The opacity percentage to animate to as a float. 
+		*						Fully Opaque = 1.0, Fully Transparent = 0.0.
+		*
+		* @param	durationMS	The number of milliseconds to animate for.
+		*
+		* @param	easing		The easing curve to use. (Optional, default is EaseInOut)
+		*/
+		void animateOpacity(float opacity, unsigned short durationMS, EasingCurve easing = EaseInOut);
+
+		/**
+		* Animates this Navi to a new absolute position. Like Navi::moveNavi, this does not change the default
+		* position of this Navi. (not applicable to NaviMaterials)
+		*
+		* @param	left	The number of pixels from the left of the Render Window to animate to.
+		*
+		* @param	top		The number of pixels from the top of the Render Window to animate to.
+		*
+		* @param	durationMS	The number of milliseconds to animate for.
+		*
+		* @param	easing		The easing curve to use. (Optional, default is EaseInOut)
+		*/
+		void animatePosition(int left, int top, unsigned short durationMS, EasingCurve easing = EaseInOut);
+
+		/**
+		* Animates the on-screen size of this Navi to a multiple of its width and height, anchored at the
+		* top-left corner. Input coordinates are scaled accordingly. (not applicable to NaviMaterials)
+		*
+		* @param	scale	The scale factor to animate to, 1.0 is the original size.
+		*
+		* @param	durationMS	The number of milliseconds to animate for.
+		*
+		* @param	easing		The easing curve to use. (Optional, default is EaseInOut)
+		*/
+		void animateScale(float scale, unsigned short durationMS, EasingCurve easing = EaseInOut);
+
 		/** 
 		* Sets the default position of this Navi to a new position and then moves
 		* the Navi to that position. (not applicable to NaviMaterials)
@@ -259,8 +373,17 @@ namespace NaviLibrary
 		*/
 		std::string getName();
 
+		/**
+		* Returns the title of the page currently loaded in this Navi, encoded as UTF-8.
+		*/
+		const std::string& getTitle() const;
+
 		/**
 		* Returns the name of the Ogre::Material used internally by this Navi.
+		*
+		* @note	When fragment programs are in use, overlay Navis that sample the same texture page and mask
+		*		share one material, so the name may change when the Navi's texture or mask does. NaviMaterials
+		*		always have a material of their own.
 		*/
 		std::string getMaterialName();
 
@@ -274,6 +397,9 @@ namespace NaviLibrary
 		* NPOT-support on the videocard by using the next-highest POT texture. Normal Navi's compensate their UV's accordingly
 		* however NaviMaterials will need to adjust their own by use of this function.
 		*
+		* @note	Navis created while NaviManager::setUseShaders is enabled compensate within their fragment program,
+		*		their derived UV's always span the whole texture.
+		*
 		* @param[out]	u1	The Ogre::Real that will be used to store the retrieved u1-coordinate.
 		* @param[out]	v1	The Ogre::Real that will be used to store the retrieved v1-coordinate.
 		* @param[out]	u2	The Ogre::Real that will be used to store the retrieved u2-coordinate.
@@ -281,6 +407,92 @@ namespace NaviLibrary
 		*/
 		void getDerivedUV(Ogre::Real& u1, Ogre::Real& v1, Ogre::Real& u2, Ogre::Real& v2);
 
+		/**
+		* Retrieves the amount of texture memory used by this Navi (including its mip chain and Alpha Mask, if any).
+		*
+		* @param[out]	allocated	The number of bytes actually allocated for this Navi. For Navis that share a
+		*							texture page (see NaviManager::setTexturePacking), this is the area of the page
+		*							reserved for this Navi.
+		*
+		* @param[out]	required	The number of bytes this Navi would need without any power-of-two padding.
+		*/
+		void getTextureMemoryUsage(size_t& allocated, size_t& required);
+
+		/**
+		* Retrieves the amount of system memory used by this Navi for pixel data (the CPU-side mip chain of
+		* mipmapped NaviMaterials, the shadow surface and the cached Alpha Mask), in bytes.
+		*/
+		size_t getSystemMemoryUsage();
+
+		/**
+		* Toggles whether or not this Navi keeps a copy of its pixels in system memory (a 'shadow surface'), so that
+		* they may be read back without locking the texture (see Navi::getShadowSurface). The shadow surface is kept
+		* up-to-date with only the regions that changed and also lets this Navi be restored instantly after its
+		* texture was lost by the render system.
+		*
+		* @param	enabled		Whether or not to keep a shadow surface. This costs 4 bytes per pixel of system memory
+		*						at the internal resolution of this Navi (see Navi::setResolutionScale).
+		*
+		* @note	Mipmapped NaviMaterials always keep a copy of their pixels when their mip chain isn't generated by the
+		*		hardware, enabling the shadow surface costs nothing extra for these.
+		*/
+		void setShadowSurface(bool enabled = true);
+
+		/**
+		* Retrieves the shadow surface of this Navi (see Navi::setShadowSurface): its pixels in 32-bit BGRA format at
+		* its internal resolution (see Navi::setResolutionScale), as of its last update. Only the alpha values of the
+		* shadow surface are undefined.
+		*
+		* @param[out]	pitch	The number of bytes between the start of two rows.
+		*
+		* @return	A pointer to the first pixel, or 0 if this Navi has no shadow surface (or its texture was evicted
+		*			to stay within the memory budget, see NaviManager::setMemoryBudget). The pointer is invalidated
+		*			by the next call to NaviManager::Update.
+		*/
+		const unsigned char* getShadowSurface(size_t& pitch);
+
+		/**
+		* Captures the current contents of this Navi into an image, for example to generate a thumbnail. The pixels
+		* are taken from the shadow surface or mip chain if available (see Navi::setShadowSurface), otherwise the
+		* WebView is rendered into system memory; the texture is never read back.
+		*
+		* @param[out]	image	The image to store the capture in, in 32-bit BGRA format (fully opaque).
+		*
+		* @param	width	The width of the capture in pixels, 0 to use the width of this Navi. (Optional, default is 0)
+		*
+		* @param	height	The height of the capture in pixels, 0 to use the height of this Navi. (Optional, default is 0)
+		*
+		* @note	To downsample on another thread instead, copy the shadow surface and pass it to NaviUtilities::scaleBGRA.
+		*/
+		void captureToImage(Ogre::Image& image, unsigned short width = 0, unsigned short height = 0);
+
+		/**
+		* Shows an in-memory image in the page without encoding it as a data URI. The image is drawn straight into
+		* this Navi's texture over every element of the page that has a matching 'naviimage' attribute (requires
+		* Navi.js), stretched to the size of the element, ex: <div naviimage="minimap" style="width: 128px; height: 128px"></div>
+		*
+		* Calling this again with the same name only replaces the pixels; just the area of the element is re-uploaded,
+		* the page itself isn't rendered again.
+		*
+		* @param	name	The name of the image, must not contain ',' or ';' (an exception is thrown if it does).
+		*
+		* @param	pixels	The pixels of the image in 32-bit BGRA format (PF_A8R8G8B8). The pixels are copied. Navi textures
+		*					have no alpha channel, so the alpha of the image is ignored and it is drawn opaque; use
+		*					Navi::setMask to make parts of the Navi transparent.
+		*
+		* @param	width	The width of the image.
+		*
+		* @param	height	The height of the image.
+		*
+		* @param	rowPitch	The number of bytes between the start of two rows, 0 if they are tightly packed. (Optional, default is 0)
+		*/
+		void setImage(const std::string& name, const unsigned char* pixels, unsigned short width, unsigned short height, size_t rowPitch = 0);
+
+		/**
+		* Removes an image previously set with Navi::setImage, the page is shown underneath again.
+		*/
+		void removeImage(const std::string& name);
+
 		/**
 		* Injects the mouse's current coordinates (in this Navi's own local coordinate space, see Navi::getRelativeX and 
 		* Navi::getRelativeY) into this Navi.
@@ -322,8 +534,15 @@ namespace NaviLibrary
 	protected:
 		Awesomium::WebView* webView;
 		std::string naviName;
+		std::string pageTitle;
 		unsigned short naviWidth;
 		unsigned short naviHeight;
+		unsigned short renderWidth;
+		unsigned short renderHeight;
+		float resolutionScale;
+		enum { LoadNone, LoadURL, LoadFile, LoadHTML } lastLoadType;
+		std::string lastLoad;
+		std::map<std::string, Awesomium::JSValue> propertyMap;
 		unsigned int winWidth;
 		unsigned int winHeight;
 		Ogre::RenderWindow* renderWindow;
@@ -333,12 +552,29 @@ namespace NaviLibrary
 		Ogre::Overlay* overlay;
 		Ogre::PanelOverlayElement* panel;
 		unsigned int maxUpdatePS;
+		Ogre::SceneNode* lodAnchor;
+		Ogre::Real lodFullRateDistance;
+		Ogre::Real lodMinRateDistance;
+		Ogre::Real lodFullRateCoverage;
+		Ogre::Real projectedCoverage;
+		unsigned int lodMinUpdatePS;
 		Ogre::Timer timer;
 		unsigned long lastUpdateTime;
 		float opacity;
 		bool usingMask;
+		bool maskOpaque;
+		std::string maskName;
+		std::string maskGroup;
 		unsigned char* maskCache;
 		size_t maskPitch;
+		enum ShaderConstant
+		{
+			ShaderNaviParams,
+			ShaderBaseRect,
+			ShaderMaskRect,
+			ShaderConstantCount
+		};
+
 		Ogre::Pass* matPass;
 		Ogre::TextureUnitState* baseTexUnit;
 		Ogre::TextureUnitState* maskTexUnit;
@@ -348,26 +584,65 @@ namespace NaviLibrary
 		bool isMaterial;
 		bool okayToDelete;
 		bool isVisible;
-		bool fadingOut;
-		unsigned long fadingOutStart;
-		unsigned long fadingOutEnd;
-		bool fadingIn;
-		unsigned long fadingInStart;
-		unsigned long fadingInEnd;
+		float fadeOpacity;
+		float appliedOpacity;
+		float scale;
 		bool compensateNPOT;
+		bool usingShaders;
+		bool sharingMaterial;
+		std::string materialName;
+		Ogre::Vector4 shaderConstants[ShaderConstantCount];
+		Ogre::ManualObject* compositeQuad;
+		Ogre::SceneNode* compositeNode;
+		bool isOccluded;
+		bool textureEvicted;
+		bool needsRefresh;
+		bool awaitingRestore;
+		bool zoomPending;
+		unsigned long lastVisibleFrame;
 		unsigned short texWidth;
 		unsigned short texHeight;
+		Ogre::PixelFormat texFormat;
 		size_t texDepth;
 		size_t texPitch;
+		unsigned short maskTexWidth;
+		unsigned short maskTexHeight;
+		std::string textureName;
+		bool texturePacked;
+		unsigned short atlasLeft, atlasTop, atlasWidth, atlasHeight;
+		int texUsage;
+		size_t texMipmaps;
+		bool useMipmaps;
+		unsigned char* mipChain;
+		std::vector<size_t> mipOffsets;
+		bool useShadowSurface;
+		unsigned char* shadowSurface;
+		unsigned char* shadowBuffer;
+		size_t shadowPitch;
+		std::vector<unsigned char> packBuffer;
 		std::map<std::string, NaviDelegate> delegateMap;
 
+		struct NaviImage
+		{
+			std::vector<unsigned char> pixels;
+			unsigned short width, height;
+			std::vector<unsigned char> scaled;
+			bool hasRegion;
+			int regionLeft, regionTop, regionWidth, regionHeight;
+
+			NaviImage() : width(0), height(0), hasRegion(false), regionLeft(0), regionTop(0), regionWidth(0), regionHeight(0) {}
+		};
+
+		std::map<std::string, NaviImage> imageMap;
+		Ogre::Box dirtyImageRect;
+
 		friend class NaviManager;
 
 		Navi(Ogre::RenderWindow* renderWin, std::string name, const NaviPosition &naviPosition,
 			unsigned short width, unsigned short height, unsigned short zOrder);
 
 		Navi(Ogre::RenderWindow* renderWin, std::string name, unsigned short width, unsigned short height, 
-			Ogre::FilterOptions texFiltering);
+			Ogre::FilterOptions texFiltering, bool mipmaps);
 
 		~Navi();
 
@@ -375,12 +650,77 @@ namespace NaviLibrary
 
 		void createWebView();
 
+		void createTexture();
+
+		void destroyTexture();
+
+		void updateTextureRects();
+
+		void evictTexture();
+
+		void restoreTexture();
+
 		void createMaterial(Ogre::FilterOptions texFiltering = Ogre::FO_NONE);
 
+		void bindSharedMaterial();
+
+		void setShaderConstant(ShaderConstant constant, const Ogre::Vector4& value);
+
+		void applyShaderConstants(Ogre::Renderable* renderable) const;
+
 		void loadResource(Ogre::Resource* resource);
 
 		void update();
 
+		unsigned int getUpdateRate() const;
+
+		int toRenderX(int x) const;
+
+		int toRenderY(int y) const;
+
+		void createMipChain();
+
+		void uploadMipChain(size_t left, size_t top, size_t right, size_t bottom);
+
+		void createShadowSurface();
+
+		void destroyShadowSurface();
+
+		void uploadShadowSurface(size_t left, size_t top, size_t right, size_t bottom);
+
+		void blitToTexture(const Ogre::HardwarePixelBufferSharedPtr& pixelBuffer, const unsigned char* src, size_t srcRowPitch, 
+			const Ogre::Box& srcRect, size_t destLeft, size_t destTop);
+
+		bool getImageRect(const NaviImage& image, Ogre::Box& rect) const;
+
+		bool getImagesRect(Ogre::Box& rect) const;
+
+		void scaleImage(NaviImage& image);
+
+		void invalidateImage(const NaviImage& image);
+
+		void drawImages(unsigned char* dest, size_t destPitch, size_t destDepth, const Ogre::Box& rect);
+
+		void updateImageRegions(const std::string& regions);
+
+		void applyOpacity();
+
+		bool isOpaque() const;
+
+		bool isOnScreen() const;
+
+		bool isShowing() const;
+
+		void beginRestore();
+
+		void applyZoom();
+
+		void updateOverlayVisibility();
+
+		void updateCompositeQuad(unsigned int layerWidth, unsigned int layerHeight);
+
+		void applyTween(NaviManager::TweenProperty property, float valueA, float valueB, bool finished);
+
 		bool isPointOverMe(int x, int y);
 
 		void windowMoved(Ogre::RenderWindow* rw);
@@ -90,6 +90,57 @@ namespace NaviLibrary
 		NaviPosition(short absoluteLeft, short absoluteTop);
 	};
 
+	/**
+	* Enumerates the easing curves that may be used to animate a Navi. Used by Navi::animateOpacity,
+	* Navi::animatePosition and Navi::animateScale
+	*/
+	enum EasingCurve
+	{
+		EaseLinear,
+		EaseIn,
+		EaseOut,
+		EaseInOut
+	};
+
+	/**
+	* Statistics gathered over the course of a single frame (the span between two calls to NaviManager::Update).
+	* Used by NaviManager::getFrameStats
+	*/
+	struct NaviFrameStats
+	{
+		/**
+		* The number of times a Navi material/pass was modified (texture units added/removed/re-targeted,
+		* fixed-function blend operations changed). Each of these may force the render system to re-validate
+		* the material.
+		*/
+		unsigned int materialStateChanges;
+
+		/**
+		* The number of times the composited Navi layer was re-rendered (see NaviManager::setCompositing).
+		*/
+		unsigned int compositeUpdates;
+
+		/**
+		* The number of Navi uploads that were skipped because the Navi was completely covered by opaque
+		* Navis with a higher Z-Order. Covered Navis are refreshed as soon as they are uncovered.
+		*/
+		unsigned int culledUploads;
+
+		/**
+		* The number of Navi updates that were skipped because the Navi had changes to show but was hidden, fully
+		* transparent or positioned entirely outside of the Render Window. These Navis are refreshed once they are
+		* visible again.
+		*/
+		unsigned int suppressedUpdates;
+
+		/**
+		* The number of Navis whose texture was restored after being lost by the render system.
+		*/
+		unsigned int restoredNavis;
+
+		NaviFrameStats() : materialStateChanges(0), compositeUpdates(0), culledUploads(0), suppressedUpdates(0), restoredNavis(0) {}
+	};
+
 	/**
 	* Enumerates internal mouse button IDs. Used by NaviManager::injectMouseDown, NaviManager::injectMouseUp
 	*/
@@ -105,7 +156,7 @@ namespace NaviLibrary
 	*
 	* The class you will need to go to for all your Navi-related needs.
 	*/
-	class _NaviExport NaviManager : public Singleton<NaviManager>, public Impl::HookListener
+	class _NaviExport NaviManager : public Singleton<NaviManager>, public Impl::HookListener, public Ogre::ManualResourceLoader
 	{
 	public:
 		/**
@@ -143,8 +194,8 @@ namespace NaviLibrary
 		static NaviManager* GetPointer();
 
 		/**
-		* Gives each active Navi a chance to update, each may or may not update their internal textures
-		* based on various conditions.
+		* Advances all active Navi animations and gives each active Navi a chance to update, each may or
+		* may not update their internal textures based on various conditions.
 		*/
 		void Update();
 
@@ -194,10 +245,15 @@ namespace NaviLibrary
 		*							applied to a 3D object, FO_ANISOTROPIC is the best (and default) choice, otherwise set this to
 		*							FO_NONE for use in other overlays/GUI elements.
 		*
+		* @param	mipmaps		Whether or not to maintain a mip chain for this material (Optional, default is false).
+		*						Recommended for NaviMaterials that are viewed from a distance. The mip chain is generated
+		*						by the hardware when supported, otherwise only the changed region of each level is
+		*						regenerated on the CPU.
+		*
 		* @throws	Ogre::Exception::ERR_RT_ASSERTION_FAILED	Throws this if a Navi by the same name already exists.
 		*/
 		Navi* createNaviMaterial(const std::string &naviName, unsigned short width, unsigned short height,
-			Ogre::FilterOptions texFiltering = Ogre::FO_ANISOTROPIC);
+			Ogre::FilterOptions texFiltering = Ogre::FO_ANISOTROPIC, bool mipmaps = false);
 
 		/**
 		* Retrieve a pointer to a Navi by name.
@@ -291,9 +347,185 @@ namespace NaviLibrary
 		*/
 		void deFocusAllNavis();
 
+		/**
+		* Toggles the programmable-pipeline path for Navis created after this call. When enabled, all Navis share
+		* a single fragment program and their opacity, mask and texture rectangle are passed as program constants
+		* instead of being baked into fixed-function texture unit state, so changing them never modifies the material.
+		*
+		* @param	useShaders	Whether or not to use the shared fragment program.
+		*
+		* @note	If the render system doesn't support fragment programs (HLSL or GLSL), Navis silently
+		*		fall back to the fixed-function path.
+		*
+		* @note	When enabled, the derived UV's (see Navi::getDerivedUV) of every Navi span the whole texture
+		*		since NPOT-compensation is handled by the program.
+		*/
+		void setUseShaders(bool useShaders = true);
+
+		/**
+		* Toggles compositing mode. When enabled, all Navis (except NaviMaterials) are rendered into a single
+		* screen-sized texture which is then displayed by one full-screen overlay. The texture is only re-rendered
+		* when the content, position, size, opacity, visibility or Z-Order of a Navi changes; on all other
+		* frames the Navis cost a single textured quad.
+		*
+		* @param	enabled		Whether or not to composite all Navis into a single layer.
+		*
+		* @note	While compositing, Navis are drawn as one overlay at the highest Z-Order of any Navi, so other
+		*		(non-Navi) overlays can no longer be interleaved between individual Navis.
+		*/
+		void setCompositing(bool enabled = true);
+
+		/**
+		* Sets the camera used for distance-based level of detail. Navis that have been anchored to the scene
+		* (see Navi::setLODAnchor) update less often the farther they are from this camera.
+		*
+		* @param	camera	The camera to measure distances from. Pass 0 to disable distance-based LOD.
+		*/
+		void setLODCamera(Ogre::Camera* camera);
+
+		/**
+		* Toggles texture packing. On systems that lack (unrestricted) NPOT-texture support, each Navi would otherwise
+		* be padded out to the next power-of-two texture (an 800x600 Navi takes up a 1024x1024 texture). When enabled,
+		* Navis created afterwards (except NaviMaterials) instead share power-of-two texture pages and only the area
+		* each Navi uses is cleared and uploaded.
+		*
+		* @param	enabled		Whether or not to pack Navis into shared texture pages.
+		*
+		* @param	pageSize	The width and height of each texture page. Navis larger than this get their own texture.
+		*						(Optional, default is 1024)
+		*/
+		void setTexturePacking(bool enabled = true, unsigned short pageSize = 1024);
+
+		/**
+		* Retrieves the amount of texture memory used by all Navis. (see Navi::getTextureMemoryUsage)
+		*
+		* @param[out]	allocated	The number of bytes allocated for all Navi textures, including texture pages.
+		*
+		* @param[out]	required	The number of bytes all Navis would need without any padding.
+		*/
+		void getTextureMemoryUsage(size_t& allocated, size_t& required);
+
+		/**
+		* Retrieves the amount of system memory used by all Navis for pixel data. (see Navi::getSystemMemoryUsage)
+		*/
+		size_t getSystemMemoryUsage();
+
+		/**
+		* Sets a memory budget for all Navis. Whenever a budget is exceeded, the textures of Navis that can't currently
+		* be seen (hidden, fully transparent or off-screen) are evicted, least-recently-visible first, and a line is
+		* written to the Ogre log. Evicted Navis are re-rendered from their page as soon as they become visible again.
+		*
+		* @param	textureBytes	The texture memory budget in bytes (see NaviManager::getTextureMemoryUsage),
+		*							0 for no limit (default).
+		*
+		* @param	systemBytes		The system memory budget in bytes (see NaviManager::getSystemMemoryUsage),
+		*							0 for no limit (default).
+		*
+		* @note	Alpha Masks and the textures of NaviMaterials are never evicted. Texture pages (see NaviManager::setTexturePacking) are only released
+		*		once all Navis on them have been evicted.
+		*/
+		void setMemoryBudget(size_t textureBytes, size_t systemBytes = 0);
+
+		/**
+		* Limits how much is re-rendered per frame after the render system has lost the Navi textures (for example
+		* when alt-tabbing out of a full-screen Direct3D application). Affected Navis are hidden until they have
+		* been re-rendered; visible Navis are restored first, top-most first, and the work is spread over as many
+		* frames as needed. At least one Navi is restored every frame.
+		*
+		* @param	pixelsPerFrame	The maximum number of pixels to re-render per frame for restoration.
+		*							(Optional, default is 1048576)
+		*/
+		void setRestoreBudget(unsigned int pixelsPerFrame = 1048576);
+
+		/**
+		* Reads page assets (HTML, scripts and stylesheets) from an Ogre resource group into memory, so that
+		* Navi::loadFile no longer reads them from the base directory. The group may contain any Ogre archive,
+		* such as a Zip archive. Pages are assembled once (their cached scripts and stylesheets inlined) and shared
+		* by all Navis that load them.
+		*
+		* @param	groupName	The name of the resource group to read from.
+		*
+		* @param	pattern		A wildcard pattern of the resources to read. (Optional, default is "*")
+		*
+		* @note	Resource names are matched against the file names passed to Navi::loadFile and the relative URLs
+		*		in pages (relative to the page, "." and ".." are resolved). Everything else, including images, is
+		*		still loaded from the base directory: cached pages get a <base> that points at their directory
+		*		(unless they have one), and relative url(...) references in inlined stylesheets are made absolute.
+		*/
+		void preloadResources(const std::string& groupName, const std::string& pattern = "*");
+
+		/**
+		* Adds a page asset to the resource cache (see NaviManager::preloadResources), for example after reading
+		* it from a pack file.
+		*
+		* @param	name	The file name of the asset, relative to the base directory.
+		*
+		* @param	data	The contents of the asset.
+		*/
+		void addResource(const std::string& name, const std::string& data);
+
+		/**
+		* Removes all assets from the resource cache. Pages loaded afterwards are read from the base directory again.
+		*/
+		void clearResources();
+
+		/**
+		* Retrieves the amount of memory used by the resource cache, including assembled pages.
+		*/
+		size_t getResourceCacheSize();
+
+		/**
+		* Retrieves the statistics gathered during the last frame (from the previous call to NaviManager::Update
+		* up to and including the last call).
+		*/
+		const NaviFrameStats& getFrameStats() const;
+
 	protected:
 		friend class Navi; // Our very close friend <3
 
+		enum TweenProperty
+		{
+			TweenOpacity,
+			TweenFade,
+			TweenPosition,
+			TweenScale
+		};
+
+		struct TexturePageRect
+		{
+			unsigned short left, top, width, height;
+
+			TexturePageRect(unsigned int left, unsigned int top, unsigned int width, unsigned int height)
+				: left(left), top(top), width(width), height(height) {}
+		};
+
+		struct TexturePage
+		{
+			std::string textureName;
+			unsigned short size;
+			std::vector<TexturePageRect> freeRects;
+			unsigned int numNavis;
+		};
+
+		struct SharedMaterial
+		{
+			std::string materialName;
+			unsigned int numNavis;
+
+			SharedMaterial() : numNavis(0) {}
+		};
+
+		struct Tween
+		{
+			Navi* navi;
+			TweenProperty property;
+			float from[2];
+			float to[2];
+			unsigned long startTime;
+			unsigned long duration;
+			EasingCurve easing;
+		};
+
 		Awesomium::WebCore* webCore;
 		std::map<std::string,Navi*> activeNavis;
 		Navi* focusedNavi;
@@ -303,6 +535,62 @@ namespace NaviLibrary
 		bool mouseButtonRDown;
 		unsigned short zOrderCounter;
 		Impl::KeyboardHook* keyboardHook;
+		std::vector<Tween> activeTweens;
+		Ogre::Timer animationTimer;
+		NaviFrameStats frameStats;
+		NaviFrameStats lastFrameStats;
+		bool useShaders;
+		bool shadersSupported;
+		std::string shaderProgramName;
+		std::map<std::string, SharedMaterial> sharedMaterials;
+		unsigned int sharedMaterialCounter;
+		bool compositing;
+		bool compositeDirty;
+		Ogre::SceneManager* compositeSceneMgr;
+		Ogre::Camera* compositeCamera;
+		Ogre::Overlay* compositeOverlay;
+		Ogre::PanelOverlayElement* compositePanel;
+		unsigned int compositeWidth;
+		unsigned int compositeHeight;
+		Ogre::Camera* lodCamera;
+		bool texturePacking;
+		unsigned short texturePageSize;
+		std::vector<TexturePage> texturePages;
+		unsigned int texturePageCounter;
+		size_t textureMemoryBudget;
+		size_t systemMemoryBudget;
+		unsigned long frameCounter;
+		unsigned int restoreBudget;
+		std::map<std::string, std::string> resourceCache;
+		std::map<std::string, std::string> pageCache;
+		std::string baseDirectoryURL;
+
+		void startTween(Navi* navi, TweenProperty property, float fromA, float fromB, float toA, float toB, 
+			unsigned long duration, EasingCurve easing);
+		void stopTween(Navi* navi, TweenProperty property);
+		void stopAllTweens(Navi* navi);
+		void updateTweens();
+		const std::string& getShaderProgram();
+		const std::string& acquireSharedMaterial(const std::string& textureName, const std::string& maskTextureName);
+		void releaseSharedMaterial(const std::string& materialName);
+		void createCompositeLayer();
+		void createCompositeTexture();
+		void destroyCompositeTexture();
+		void destroyCompositeLayer();
+		void attachToComposite(Navi* navi);
+		void detachFromComposite(Navi* navi);
+		void updateCompositeLayer();
+		void updateOcclusion();
+		bool allocateTextureRect(unsigned short width, unsigned short height, std::string& textureName,
+			unsigned short& left, unsigned short& top, unsigned short& allocWidth, unsigned short& allocHeight);
+		void releaseTextureRect(const std::string& textureName, unsigned short left, unsigned short top, 
+			unsigned short width, unsigned short height);
+		void loadResource(Ogre::Resource* resource);
+		void enforceMemoryBudget();
+		void scheduleRestores();
+		const std::string* getCachedPage(const std::string& file);
+		const std::string* findResource(const std::string& directory, const std::string& url);
+		void inlineResources(const std::string& html, const std::string& directory, std::string& result);
 
 		bool focusNavi(int x, int y, Navi* selection = 0);
 		Navi* getTopNavi(int x, int y);
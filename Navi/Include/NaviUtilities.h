@@ -28,6 +28,7 @@
 
 #include "NaviPlatform.h"
 #include <string>
+#include <string.h>
 #include <iomanip>
 #include <OgreResourceGroupManager.h>
 #include <OgreLogManager.h>
@@ -84,22 +85,84 @@ namespace NaviLibrary
 		bool _NaviExport isNumeric(const std::string &numberString);
 
 		/**
-		* Converts a Number (int, float, double, bool, etc.) to a String.
+		* The size of the buffer that NaviUtilities::formatNumber requires, including the terminating null character.
+		*/
+		const size_t NumberBufferSize = 32;
+
+		/**
+		* Formats a number into a caller-supplied buffer without allocating, independent of the current locale.
+		* Integers are written in full, floating-point numbers as by NaviUtilities::formatRoundTrip.
+		*
+		* @param	value	The number to format.
+		*
+		* @param	buffer	The buffer to write the null-terminated result to, at least NaviUtilities::NumberBufferSize bytes.
+		*
+		* @return	The length of the result, excluding the terminating null character.
+		*/
+		size_t _NaviExport formatNumber(int value, char* buffer);
+		size_t _NaviExport formatNumber(unsigned int value, char* buffer);
+		size_t _NaviExport formatNumber(long value, char* buffer);
+		size_t _NaviExport formatNumber(unsigned long value, char* buffer);
+		size_t _NaviExport formatNumber(long long value, char* buffer);
+		size_t _NaviExport formatNumber(unsigned long long value, char* buffer);
+		size_t _NaviExport formatNumber(float value, char* buffer);
+		size_t _NaviExport formatNumber(double value, char* buffer);
+		size_t _NaviExport formatNumber(bool value, char* buffer);
+
+		/**
+		* Formats a floating-point number with the fewest significant digits (6 to 9 for a float, 15 to 17 for a
+		* double) that parse back to exactly the same value, so that 0.1f is written as "0.1" and 1234567.0f as
+		* "1234567". The decimal point is always '.', whatever the current locale.
+		*
+		* @param	value	The number to format.
+		*
+		* @param	buffer	The buffer to write the null-terminated result to, at least NaviUtilities::NumberBufferSize bytes.
+		*
+		* @return	The length of the result, excluding the terminating null character.
+		*/
+		size_t _NaviExport formatRoundTrip(float value, char* buffer);
+		size_t _NaviExport formatRoundTrip(double value, char* buffer);
+
+		/**
+		* Parses the number at the start of a string without allocating, independent of the current locale.
+		* Leading whitespace and a sign are skipped, parsing stops at the first character that can't be part
+		* of the number.
+		*
+		* @param	numberString	The null-terminated string to parse.
+		* @note		Strings beginning with 'true'/'false' (regardless of case) are numeric and are parsed as 1/0.
+		*
+		* @param[out]	result	The parsed number. Left untouched if parsing fails.
+		*
+		* @return	The number of characters that were parsed, or 0 if the string doesn't begin with a number
+		*			(or the number is out of range for the result type).
+		*/
+		size_t _NaviExport parseNumber(const char* numberString, int& result);
+		size_t _NaviExport parseNumber(const char* numberString, unsigned int& result);
+		size_t _NaviExport parseNumber(const char* numberString, long& result);
+		size_t _NaviExport parseNumber(const char* numberString, unsigned long& result);
+		size_t _NaviExport parseNumber(const char* numberString, long long& result);
+		size_t _NaviExport parseNumber(const char* numberString, unsigned long long& result);
+		size_t _NaviExport parseNumber(const char* numberString, float& result);
+		size_t _NaviExport parseNumber(const char* numberString, double& result);
+		size_t _NaviExport parseNumber(const char* numberString, bool& result);
+
+		/**
+		* Converts a Number (int, float, double, bool, etc.) to a String. (see NaviUtilities::formatNumber)
 		*
 		* @param	number	The number (usually of type int, float, double, bool, etc.) to convert to a String.
 		*
-		* @return	If the conversion succeeds, returns the string equivalent of the number, otherwise an empty string.
+		* @return	The string equivalent of the number.
 		*/
 		template<class NumberType>
 		inline std::string _NaviExport numberToString(const NumberType &number)
 		{
-			std::ostringstream converter;
+			char buffer[NumberBufferSize];
 
-			return (converter << std::setprecision(17) << number).fail() ? "" : converter.str();
+			return std::string(buffer, formatNumber(number, buffer));
 		}
 
 		/**
-		* Converts a String to a Number.
+		* Converts a String to a Number. (see NaviUtilities::parseNumber)
 		*
 		* @param	<NumberType>	The NumberType (int, float, bool, double, etc.) to convert to.
 		*
@@ -111,41 +174,81 @@ namespace NaviLibrary
 		template<class NumberType>
 		inline NumberType _NaviExport toNumber(const std::string &numberString)
 		{
-			if(isPrefixed(numberString, "true")) return 1;
-			else if(isPrefixed(numberString, "false")) return 0;
-
-			std::istringstream converter(numberString);
-			
-			if(typeid(NumberType)==typeid(bool))
-			{
-				int result;
-				return (converter >> result).fail() ? false : !!result;
-			}
-
 			NumberType result;
-			return (converter >> result).fail() ? 0 : result;
+
+			return parseNumber(numberString.c_str(), result) ? result : 0;
 		}
 
 		/**
-		* Converts a multibyte string (standard string) to a wide string.
+		* Converts a UTF-8 string to a wide string (UTF-16 where wchar_t is 16 bits, UTF-32 otherwise). Malformed
+		* sequences are replaced with U+FFFD. This does not depend on the current locale.
 		*
-		* @param	stringToConvert		The multibyte (standard) string to convert.
+		* @param	stringToConvert		The UTF-8 string to convert.
 		*
 		* @return	The wide-equivalent of the passed string.
 		*/
 		std::wstring _NaviExport toWide(const std::string &stringToConvert);
 
 		/**
-		* Converts a wide string to a multibyte string (standard string), based on the current locale.
+		* Converts a UTF-8 string to a wide string, reusing the storage of 'result'.
+		*/
+		void _NaviExport toWide(const std::string &stringToConvert, std::wstring &result);
+
+		/**
+		* Converts a UTF-8 buffer to a wide string in a caller-supplied buffer.
+		*
+		* @param	source	The UTF-8 data to convert.
+		*
+		* @param	length	The length of 'source', in bytes.
+		*
+		* @param	dest	The buffer to write to; never needs more than 'length' characters. Pass 0 to only
+		*					compute the length of the result.
+		*
+		* @return	The number of wide characters written (or that would be written).
+		*/
+		size_t _NaviExport toWide(const char* source, size_t length, wchar_t* dest);
+
+		/**
+		* Converts a wide string to a UTF-8 string. Unpaired surrogates are replaced with U+FFFD. This does not
+		* depend on the current locale.
 		*
 		* @param	wstringToConvert	The wide string to convert.
 		*
-		* @return	The multibyte-equivalent of the passed string, based on the current locale.
+		* @return	The UTF-8 equivalent of the passed string.
 		*/
 		std::string _NaviExport toMultibyte(const std::wstring &wstringToConvert);
 
 		/**
-		* Sets the current locale, used for 'toMultibyte()'. If you never call this, the default is usually "English". 
+		* Converts a wide string to a UTF-8 string, reusing the storage of 'result'.
+		*/
+		void _NaviExport toMultibyte(const std::wstring &wstringToConvert, std::string &result);
+
+		/**
+		* Converts a wide buffer to UTF-8 in a caller-supplied buffer.
+		*
+		* @param	source	The wide characters to convert.
+		*
+		* @param	length	The number of characters in 'source'.
+		*
+		* @param	dest	The buffer to write to. Pass 0 to only compute the length of the result.
+		*
+		* @return	The number of bytes written (or that would be written).
+		*/
+		size_t _NaviExport toMultibyte(const wchar_t* source, size_t length, char* dest);
+
+		/**
+		* Checks whether a buffer is well-formed UTF-8 (no overlong forms, surrogates or values above U+10FFFF).
+		*/
+		bool _NaviExport isValidUTF8(const char* source, size_t length);
+
+		/**
+		* Checks whether a string is well-formed UTF-8.
+		*/
+		bool _NaviExport isValidUTF8(const std::string &source);
+
+		/**
+		* Sets the current locale of the C runtime. Note that 'toWide()' and 'toMultibyte()' always use UTF-8
+		* and are not affected by this.
 		*
 		* @param	localeLanguage	The name of the locale language to set. An empty string sets this to the current locale of the OS.
 		*/
@@ -164,6 +267,190 @@ namespace NaviLibrary
 		*/
 		int _NaviExport replaceAll(std::string &sourceStr, const std::string &replaceWhat, const std::string &replaceWith);
 
+		/**
+		* A table of patterns that are all replaced in a single scan over a string, for example to escape large
+		* Javascript or HTML payloads. Build it once and reuse it: candidate patterns are looked up by their first
+		* character and, where several patterns match at the same position, the longest one wins.
+		*
+		* @note
+		*	For example:
+		*	\code
+		*	static const Replacer jsEscaper = Replacer("\\", "\\\\")("'", "\\'")("\n", "\\n")("\r", "\\r");
+		*	jsEscaper.replaceAll(payload);
+		*	\endcode
+		*/
+		class _NaviExport Replacer
+		{
+			std::vector<std::pair<std::string, std::string> > patterns;
+			std::vector<unsigned short> candidates[256];
+
+		public:
+			/**
+			* Creates an empty Replacer.
+			*/
+			Replacer();
+
+			/**
+			* Creates a Replacer with a single pattern.
+			*/
+			Replacer(const std::string &replaceWhat, const std::string &replaceWith);
+
+			/**
+			* Adds a pattern. Empty patterns are ignored.
+			*
+			* @param	replaceWhat		What to be replaced.
+			*
+			* @param	replaceWith		All occurrences of 'replaceWhat' will be replaced with this.
+			*/
+			Replacer& operator()(const std::string &replaceWhat, const std::string &replaceWith);
+
+			/**
+			* Replaces all non-overlapping occurrences of every pattern, scanning from left to right.
+			*
+			* @param	sourceStr	The string to do this to.
+			*
+			* @return	The number of instances replaced within 'sourceStr'.
+			*/
+			int replaceAll(std::string &sourceStr) const;
+		};
+
+		/**
+		* A lightweight reference to a range of characters owned by someone else (usually a std::string), used
+		* to pick strings apart without copying them. The referenced characters must outlive the StringRef.
+		*/
+		class _NaviExport StringRef
+		{
+			const char* chars;
+			size_t length;
+
+		public:
+			/**
+			* Creates an empty StringRef.
+			*/
+			StringRef() : chars(""), length(0) { }
+
+			/**
+			* Creates a StringRef to a range of characters.
+			*/
+			StringRef(const char* chars, size_t length) : chars(chars), length(length) { }
+
+			/**
+			* Creates a StringRef to a C-string.
+			*/
+			StringRef(const char* str) : chars(str), length(strlen(str)) { }
+
+			/**
+			* Creates a StringRef to the contents of a string.
+			*/
+			StringRef(const std::string& str) : chars(str.data()), length(str.length()) { }
+
+			/**
+			* Returns a pointer to the first character (not necessarily null-terminated).
+			*/
+			const char* data() const { return chars; }
+
+			/**
+			* Returns the number of characters.
+			*/
+			size_t size() const { return length; }
+
+			/**
+			* Returns whether or not there are no characters.
+			*/
+			bool empty() const { return !length; }
+
+			/**
+			* Returns a copy of the referenced characters.
+			*/
+			std::string str() const { return std::string(chars, length); }
+
+			/**
+			* Returns a StringRef to part of the referenced characters (like std::string::substr).
+			*/
+			StringRef substr(size_t offset, size_t count = std::string::npos) const;
+
+			/**
+			* Finds the first occurrence of a string at or after an offset.
+			*
+			* @return	The offset of the occurrence, or std::string::npos if there is none.
+			*/
+			size_t find(const StringRef& what, size_t offset = 0) const;
+
+			/**
+			* Compares the referenced characters with those of another StringRef.
+			*/
+			bool operator==(const StringRef& other) const { return length == other.length && !memcmp(chars, other.chars, length); }
+
+			/**
+			* Compares the referenced characters with those of another StringRef.
+			*/
+			bool operator!=(const StringRef& other) const { return !(*this == other); }
+		};
+
+		/**
+		* Lazily splits a string into tokens, one token per call to Splitter::next, without copying anything.
+		* (see NaviUtilities::split for the tokenizing rules)
+		*
+		* @note
+		*	For example:
+		*	\code
+		*	Splitter splitter(queryString, "&");
+		*	StringRef token;
+		*	while(splitter.next(token))
+		*		if(token == "debug=1")
+		*			enableDebugging();
+		*	\endcode
+		*/
+		class _NaviExport Splitter
+		{
+			StringRef source;
+			StringRef delimiter;
+			size_t position;
+			bool ignoreEmpty;
+			bool done;
+
+		public:
+			/**
+			* Creates a Splitter for a string. Both the string and the delimiter must outlive the Splitter.
+			*
+			* @param	source	The string to split up.
+			*
+			* @param	delimiter	What to delimit the source string by.
+			*
+			* @param	ignoreEmpty		Whether or not to skip empty tokens.
+			*/
+			Splitter(const StringRef& source, const StringRef& delimiter, bool ignoreEmpty = true);
+
+			/**
+			* Retrieves the next token.
+			*
+			* @param[out]	token	The StringRef to store the token in.
+			*
+			* @return	Whether or not there was another token.
+			*/
+			bool next(StringRef& token);
+		};
+
+		/**
+		* Parses a string into key-value pairs without copying anything, a reusable alternative to
+		* NaviUtilities::splitToMap for strings that are parsed often (e.g. query strings sent every frame).
+		* Unlike splitToMap, pairs are kept in order of appearance and duplicate keys are kept.
+		*
+		* @param	source	The string to parse. It must outlive the resulting pairs.
+		*
+		* @param	pairDelimiter	What to delimit pairs by.
+		*
+		* @param	keyValueDelimiter	What to delimit key-values by.
+		*
+		* @param[out]	pairs	The vector to store the pairs in, it is cleared first.
+		*
+		* @param	ignoreEmpty		Whether or not to ignore pairs with an empty key or value. Empty pairs will always be ignored.
+		*
+		* @return	The number of pairs.
+		*/
+		size_t _NaviExport splitToPairs(const StringRef& source, const StringRef& pairDelimiter, const StringRef& keyValueDelimiter, 
+			std::vector<std::pair<StringRef, StringRef> >& pairs, bool ignoreEmpty = true);
+
 		/**
 		* Splits a string up into a series of tokens (contained within a string vector), delimited by a certain string.
 		*
@@ -227,11 +514,56 @@ namespace NaviLibrary
 		/**
 		* A generic value container that can contain a string, wide string, integer, float,
 		* double, or boolean value and can convert between them on-the-fly.
+		*
+		* @note	Numbers and booleans are stored as-is and only formatted when requested as a string,
+		*		strings are stored in their original (multibyte or wide) form.
 		*/
 		class _NaviExport MultiValue
 		{
-			std::wstring value;
-			bool isWide;
+			enum ValueType { TypeEmpty, TypeString, TypeWideString, TypeInt, TypeSizeT, TypeFloat, TypeDouble, TypeBool };
+
+			ValueType type;
+			/**
+			* Only the member named by 'type' is live; a string or wide string is constructed in place in its
+			* storage and destroyed when the type changes.
+			*/
+			union
+			{
+				int intValue;
+				size_t sizeValue;
+				float floatValue;
+				double doubleValue;
+				bool boolValue;
+				void* alignment;
+				char narrowStorage[sizeof(std::string)];
+				char wideStorage[sizeof(std::wstring)];
+			} data;
+
+			std::string& narrowValue() { return *reinterpret_cast<std::string*>(data.narrowStorage); }
+			const std::string& narrowValue() const { return *reinterpret_cast<const std::string*>(data.narrowStorage); }
+			std::wstring& wideValue() { return *reinterpret_cast<std::wstring*>(data.wideStorage); }
+			const std::wstring& wideValue() const { return *reinterpret_cast<const std::wstring*>(data.wideStorage); }
+
+			/**
+			* Destroys the string held, if any, and leaves this MultiValue empty.
+			*/
+			void release();
+
+			template<class NumberType>
+			NumberType toNumberType() const
+			{
+				switch(type)
+				{
+				case TypeString: return toNumber<NumberType>(narrowValue());
+				case TypeWideString: return toNumber<NumberType>(toMultibyte(wideValue()));
+				case TypeInt: return (NumberType)data.intValue;
+				case TypeSizeT: return (NumberType)data.sizeValue;
+				case TypeFloat: return (NumberType)data.floatValue;
+				case TypeDouble: return (NumberType)data.doubleValue;
+				case TypeBool: return (NumberType)data.boolValue;
+				default: return 0;
+				}
+			}
 			
 		public:
 			/**
@@ -239,6 +571,13 @@ namespace NaviLibrary
 			*/
 			MultiValue();
 
+			/**
+			* Creates a copy of another MultiValue.
+			*/
+			MultiValue(const MultiValue &original);
+
+			~MultiValue();
+
 			/**
 			* Creates a MultiValue from a string.
 			*/
@@ -279,6 +618,11 @@ namespace NaviLibrary
 			*/
 			MultiValue(bool value);
 
+			/**
+			* Assigns this MultiValue the value of another MultiValue
+			*/
+			MultiValue& operator=(const MultiValue &value);
+
 			/**
 			* Assigns this MultiValue a string value
 			*/
@@ -326,6 +670,12 @@ namespace NaviLibrary
 			*/
 			std::string str() const;
 
+			/**
+			* Appends the value of this MultiValue, as a string, to another string without creating a temporary string
+			* (unless the value is a wide string).
+			*/
+			void appendTo(std::string &dest) const;
+
 			/**
 			* Returns whether or not the value of this MultiValue is empty
 			*/
@@ -459,9 +809,114 @@ namespace NaviLibrary
 		*	std::string myString = templateString("name: ?, strength: ?, color: ?", Args("ValhallaSword")(999)("Red"));
 		*	// myString is now = "name: ValhallaSword, strength: 999, color: Red";
 		*	\endcode
+		*
+		*	Parsed templates are cached (the 256 most recently used ones), the arguments are formatted without
+		*	holding any lock.
 		*/
 		std::string _NaviExport templateString(const std::string &templateStr, const Args &args);
 
+		/**
+		* A template string that is parsed once, when it is created, and that formats its arguments directly into a
+		* reusable string without creating any MultiValues. Meant for templates that are used over and over again,
+		* such as HUD text that is updated every frame. (see NaviUtilities::templateString for the template syntax)
+		*
+		* @note
+		*	For example:
+		*	\code
+		*	static const StringTemplate hudTemplate("setHealth(?, ?); setAmmo(?);");
+		*	hudTemplate.format(script)(health)(maxHealth)(ammo); // script is now = "setHealth(80, 100); setAmmo(12);"
+		*	\endcode
+		*/
+		class _NaviExport StringTemplate
+		{
+			std::string text;
+			std::vector<StringRef> segments;
+
+			StringTemplate(const StringTemplate&);
+			StringTemplate& operator=(const StringTemplate&);
+
+		public:
+			/**
+			* Fills in the placeholders of a StringTemplate one argument at a time, in order. Arguments beyond the
+			* last placeholder are ignored; the rest of the template is written out when the Formatter goes out of scope.
+			*/
+			class _NaviExport Formatter
+			{
+				const StringTemplate* owner;
+				std::string* output;
+				size_t nextSegment;
+				mutable bool active;
+
+				bool beginArgument() const;
+
+				void endArgument();
+
+			public:
+				Formatter(const StringTemplate& owner, std::string& output);
+
+				Formatter(const Formatter& other);
+
+				~Formatter();
+
+				/**
+				* Fills in the next placeholder with a number (see NaviUtilities::formatNumber).
+				*/
+				template<class NumberType>
+				Formatter& operator()(const NumberType& value)
+				{
+					if(beginArgument())
+					{
+						char buffer[NumberBufferSize];
+						output->append(buffer, formatNumber(value, buffer));
+						endArgument();
+					}
+
+					return *this;
+				}
+
+				/**
+				* Fills in the next placeholder with a string.
+				*/
+				Formatter& operator()(const std::string& value);
+
+				/**
+				* Fills in the next placeholder with a C-string.
+				*/
+				Formatter& operator()(const char* value);
+
+				/**
+				* Fills in the next placeholder with a wide string (see NaviUtilities::toMultibyte).
+				*/
+				Formatter& operator()(const std::wstring& value);
+
+				/**
+				* Fills in the next placeholder with a MultiValue.
+				*/
+				Formatter& operator()(const MultiValue& value);
+			};
+
+			/**
+			* Parses a template string.
+			*
+			* @param	templateStr	A string containing the template, the '?' character marks a placeholder.
+			*/
+			explicit StringTemplate(const std::string& templateStr);
+
+			/**
+			* Starts formatting this template into a string.
+			*
+			* @param	output	The string to format into. It is cleared first, its memory is reused.
+			*
+			* @return	A Formatter to pass the arguments to.
+			*/
+			Formatter format(std::string& output) const;
+
+			/**
+			* Formats this template with some arguments, like NaviUtilities::templateString.
+			*/
+			std::string operator()(const Args& args) const;
+		};
+
 		/**
 		* A super-easy way to log messages to the Ogre LogManager. For example, instead of: 
 		* \code LogManager::GetSingleton().logMessage(templateString("a: ?, b: ?"), Args(a)(b))); \endcode
@@ -470,6 +925,43 @@ namespace NaviLibrary
 		* @note	See NaviUtilities::templateString for more information.
 		*/
 		void _NaviExport logTemplate(const std::string &templateStr, const Args &args);
+
+		/**
+		* Same as above, without copying the template into a std::string. When asynchronous logging is enabled,
+		* the message is queued rather than written. (see NaviUtilities::setAsyncLogging)
+		*/
+		void _NaviExport logTemplate(const char* templateStr, const Args &args);
+
+		/**
+		* Toggles asynchronous logging for NaviUtilities::logTemplate. Messages are formatted by the caller and then
+		* handed to a lock-free queue; they are written to the Ogre log in batches by a background thread (on Windows,
+		* when Ogre was built with thread support, otherwise by NaviManager::Update) so that logging never waits on
+		* the disk.
+		*
+		* @param	enabled		Whether or not to log asynchronously. Disabling waits for messages that are being
+		*						queued by other threads and then writes out all queued messages.
+		*
+		* @param	maxQueuedMessages	The maximum number of messages waiting to be written. Further messages are
+		*								dropped (and counted, see NaviUtilities::getLogStats) until the queue drains.
+		*								(Optional, default is 4096)
+		*/
+		void _NaviExport setAsyncLogging(bool enabled, size_t maxQueuedMessages = 4096);
+
+		/**
+		* Writes out the messages queued by asynchronous logging. This is called by NaviManager::Update, you only
+		* need to call it yourself when logging before the NaviManager exists or after it is destroyed. When
+		* messages are written by a background thread, this only wakes it up.
+		*/
+		void _NaviExport flushLog();
+
+		/**
+		* Retrieves the counters of asynchronous logging.
+		*
+		* @param[out]	written		The number of messages written to the Ogre log.
+		* @param[out]	dropped		The number of messages dropped because the queue was full.
+		* @param[out]	queued		The number of messages currently waiting to be written.
+		*/
+		void _NaviExport getLogStats(size_t& written, size_t& dropped, size_t& queued);
 		
 		/**
 		* Converts a Hex Color String to R, G, B values.
@@ -493,6 +985,137 @@ namespace NaviLibrary
 		*/
 		std::string _NaviExport encodeBase64(const std::string &strToEncode);
 
+		/**
+		* Returns the number of characters 'encodeBase64' produces for 'length' bytes of input (including padding).
+		*/
+		size_t _NaviExport getBase64EncodedLength(size_t length);
+
+		/**
+		* Encodes a buffer into Base64 (with padding) in a caller-supplied buffer, such as when building data URIs for images.
+		*
+		* @param	src		The data to encode.
+		*
+		* @param	length	The length of 'src', in bytes.
+		*
+		* @param	dest	The buffer to write to, must hold at least 'getBase64EncodedLength(length)' characters.
+		*					No null-terminator is written.
+		*
+		* @return	The number of characters written.
+		*/
+		size_t _NaviExport encodeBase64(const unsigned char* src, size_t length, char* dest);
+
+		/**
+		* Returns the maximum number of bytes 'decodeBase64' produces for 'length' characters of input.
+		*/
+		size_t _NaviExport getBase64DecodedLength(size_t length);
+
+		/**
+		* Decodes Base64 (padded or unpadded, without whitespace) into a caller-supplied buffer.
+		*
+		* @param	src		The Base64 characters to decode.
+		*
+		* @param	length	The number of characters in 'src'.
+		*
+		* @param	dest	The buffer to write to, must hold at least 'getBase64DecodedLength(length)' bytes.
+		*
+		* @param	decodedLength	Receives the number of bytes written.
+		*
+		* @return	Returns whether or not 'src' was valid Base64.
+		*/
+		bool _NaviExport decodeBase64(const char* src, size_t length, unsigned char* dest, size_t &decodedLength);
+
+		/**
+		* Decodes a Base64 string.
+		*
+		* @param	strToDecode		The Base64 string to decode.
+		*
+		* @param	result		Receives the decoded data (cleared if 'strToDecode' is invalid).
+		*
+		* @return	Returns whether or not 'strToDecode' was valid Base64.
+		*/
+		bool _NaviExport decodeBase64(const std::string &strToDecode, std::string &result);
+
+		/**
+		* Box-filters a region of a 32-bit (BGRA) image into the next-smaller mipmap level. Both images are
+		* tightly packed (row pitch = width * 4). Source texels beyond the edge of an odd-sized image are clamped.
+		* An empty source image leaves 'dest' untouched.
+		*
+		* @param	src			The source (larger) image.
+		* @param	srcWidth	The width of the source image, in pixels.
+		* @param	srcHeight	The height of the source image, in pixels.
+		* @param	dest		The destination (smaller) image.
+		* @param	destWidth	The width of the destination image, in pixels.
+		* @param	left, top, right, bottom	The region of the destination image to update, in pixels.
+		*/
+		void _NaviExport downsampleBGRA(const unsigned char* src, size_t srcWidth, size_t srcHeight,
+			unsigned char* dest, size_t destWidth, size_t left, size_t top, size_t right, size_t bottom);
+
+		/**
+		* Resamples a 32-bit (BGRA) image to an arbitrary size: the image is repeatedly box-filtered to half its size
+		* (see NaviUtilities::downsampleBGRA) for as long as it remains at least as large as the destination, the
+		* remainder is bilinearly filtered. This doesn't touch the render system and may be called from any thread.
+		* Nothing is done if either image is empty (a width or height of 0).
+		*
+		* @param	src			The source image.
+		* @param	srcWidth	The width of the source image, in pixels.
+		* @param	srcHeight	The height of the source image, in pixels.
+		* @param	srcPitch	The number of bytes between the start of two rows of the source image.
+		* @param	dest		The destination image, tightly packed (row pitch = destWidth * 4).
+		* @param	destWidth	The width of the destination image, in pixels.
+		* @param	destHeight	The height of the destination image, in pixels.
+		*/
+		void _NaviExport scaleBGRA(const unsigned char* src, size_t srcWidth, size_t srcHeight, size_t srcPitch,
+			unsigned char* dest, size_t destWidth, size_t destHeight);
+
+		/**
+		* Converts a row of 32-bit (BGRA) pixels to 24-bit (BGR) pixels by dropping the alpha channel.
+		*
+		* @param	src		The source pixels.
+		* @param	dest	The destination pixels, 3 bytes per pixel.
+		* @param	count	The number of pixels to convert.
+		*
+		* @note	This and the following pixel conversions pick the widest instruction set the CPU supports (detected
+		*		once, via CPUID) and fall back to plain C++; they may be called from any thread. SSSE3 paths need
+		*		VC9 or later and AVX2 paths VC11 or later, builds with older compilers only use SSE2.
+		*/
+		void _NaviExport packBGRAtoBGR(const unsigned char* src, unsigned char* dest, size_t count);
+
+		/**
+		* Converts a row of 24-bit (BGR) pixels to 32-bit (BGRA) pixels.
+		*
+		* @param	src		The source pixels, 3 bytes per pixel.
+		* @param	dest	The destination pixels.
+		* @param	count	The number of pixels to convert.
+		* @param	alpha	The alpha value to give every pixel. (Optional, default is 255)
+		*/
+		void _NaviExport expandBGRtoBGRA(const unsigned char* src, unsigned char* dest, size_t count, unsigned char alpha = 255);
+
+		/**
+		* Multiplies the color channels of a row of 32-bit (BGRA) pixels by their alpha, in-place.
+		*
+		* @param	pixels	The pixels to premultiply.
+		* @param	count	The number of pixels.
+		*/
+		void _NaviExport premultiplyBGRA(unsigned char* pixels, size_t count);
+
+		/**
+		* Divides the color channels of a row of premultiplied 32-bit (BGRA) pixels by their alpha, in-place.
+		* Fully transparent pixels become black.
+		*
+		* @param	pixels	The pixels to un-premultiply.
+		* @param	count	The number of pixels.
+		*/
+		void _NaviExport unpremultiplyBGRA(unsigned char* pixels, size_t count);
+
+		/**
+		* Copies the alpha channel of a row of 32-bit pixels that store alpha in their last byte (BGRA or RGBA).
+		*
+		* @param	src		The source pixels.
+		* @param	dest	The destination alpha values, 1 byte per pixel.
+		* @param	count	The number of pixels.
+		*/
+		void _NaviExport extractAlpha(const unsigned char* src, unsigned char* dest, size_t count);
+
 		/**
 		* Ensures that a number (input) is within certain limits.
 		*
@@ -7367,6 +7367,85 @@ if(window.document.URL.test(/\?(.*)\?(.*)/g))
 	
 window.addEvent('domready', function(){	$ND('ready').send(); });
 
+/**
+* Lets the application draw in-memory images (see Navi::setImage) straight into the page, without encoding them as data URIs.
+* Give any element a 'naviimage' attribute with the name of the image to show; the image is stretched over the element.
+* Names containing ',' or ';' are ignored.
+*
+* Example:
+* <div naviimage="minimap" style="width: 128px; height: 128px"></div>
+*
+* @note	The positions of these elements are reported when the page is ready, resized or scrolled and whenever the document
+*		changes (through a MutationObserver, or DOM mutation events where it isn't available). Call 'NaviImage.update()' yourself
+*		when they move in a way the document doesn't see, e.g. through a CSS transition.
+*/
+var NaviImage = {
+
+	lastRegions: null,
+	timer: null,
+
+	update: function()
+	{
+		NaviImage.timer = $clear(NaviImage.timer);
+		
+		if(!$defined(window.Client) || !$defined(Client.NaviImageRegions))
+			return;
+		
+		// Coordinates are reported in CSS pixels, the page is rendered with its zoom applied (see Navi::setResolutionScale)
+		var zoom = parseFloat(document.documentElement.style.zoom) || 1;
+		var scrollLeft = window.getScrollLeft(), scrollTop = window.getScrollTop();
+		var regions = [];
+		
+		$A(document.getElementsByTagName('*')).each(function(ele)
+		{
+			var imageName = ele.getAttribute('naviimage');
+			
+			// ',' and ';' delimit the reported regions, Navi::setImage refuses such names
+			if($chk(imageName) && !/[,;]/.test(imageName))
+			{
+				var coords = $(ele).getCoordinates();
+				regions.push([imageName, Math.round((coords.left - scrollLeft) * zoom), Math.round((coords.top - scrollTop) * zoom), 
+					Math.round(coords.width * zoom), Math.round(coords.height * zoom)].join(','));
+			}
+		});
+		
+		regions = regions.join(';');
+		
+		if(regions == NaviImage.lastRegions)
+			return;
+		
+		NaviImage.lastRegions = regions;
+		Client.NaviImageRegions(regions);
+	},
+	
+	// Coalesces bursts of changes into a single update
+	schedule: function()
+	{
+		if(!NaviImage.timer)
+			NaviImage.timer = NaviImage.update.delay(15);
+	},
+	
+	observe: function()
+	{
+		NaviImage.update();
+		
+		if($defined(window.MutationObserver) || $defined(window.WebKitMutationObserver))
+		{
+			var Observer = window.MutationObserver || window.WebKitMutationObserver;
+			new Observer(NaviImage.schedule).observe(document.documentElement, { attributes: true, childList: true, characterData: true, subtree: true });
+		}
+		else
+		{
+			document.addEventListener('DOMSubtreeModified', NaviImage.schedule, false);
+			document.addEventListener('DOMAttrModified', NaviImage.schedule, false);
+		}
+	}
+};
+
+window.addEvent('domready', NaviImage.observe);
+window.addEvent('resize', NaviImage.update);
+window.addEvent('scroll', NaviImage.update);
+
 /**
 * Native combo-boxes (<select>) refuse to work properly in our context. This NaviWidget class essentially emulates native combo-boxes using MooTools/CSS/HTML.
 *
@@ -35,6 +35,10 @@ Navi::Navi(Ogre::RenderWindow* renderWin, std::string name, const NaviPosition &
 	naviName = name;
 	naviWidth = width;
 	naviHeight = height;
+	renderWidth = width;
+	renderHeight = height;
+	resolutionScale = 1;
+	lastLoadType = LoadNone;
 	winWidth = renderWin->getWidth();
 	winHeight = renderWin->getHeight();
 	renderWindow = renderWin;
@@ -44,22 +48,51 @@ Navi::Navi(Ogre::RenderWindow* renderWin, std::string name, const NaviPosition &
 	overlay = 0;
 	panel = 0;
 	maxUpdatePS = 0;
+	lodAnchor = 0;
+	lodFullRateDistance = 0;
+	lodMinRateDistance = 0;
+	lodFullRateCoverage = 0;
+	projectedCoverage = -1;
+	lodMinUpdatePS = 1;
 	lastUpdateTime = 0;
 	opacity = 1;
 	usingMask = false;
+	maskOpaque = false;
 	ignoringTrans = true;
 	transparent = 0.05;
 	ignoringBounds = false;
 	isMaterial = false;
 	okayToDelete = false;
 	isVisible = true;
-	fadingOut = false;
-	fadingOutStart = fadingOutEnd = 0;
-	fadingIn = false;
-	fadingInStart = fadingInEnd = 0;
+	fadeOpacity = 1;
+	appliedOpacity = -1;
+	scale = 1;
 	compensateNPOT = false;
+	usingShaders = false;
+	sharingMaterial = false;
+	compositeQuad = 0;
+	compositeNode = 0;
+	isOccluded = false;
+	awaitingRestore = false;
+	zoomPending = false;
+	textureEvicted = false;
+	needsRefresh = false;
+	lastVisibleFrame = 0;
 	texWidth = width;
 	texHeight = height;
+	maskTexWidth = width;
+	maskTexHeight = height;
+	textureName = name + "Texture";
+	texturePacked = false;
+	atlasLeft = atlasTop = atlasWidth = atlasHeight = 0;
+	texUsage = TU_DYNAMIC_WRITE_ONLY_DISCARDABLE;
+	texMipmaps = 0;
+	useMipmaps = false;
+	mipChain = 0;
+	useShadowSurface = false;
+	shadowSurface = 0;
+	shadowBuffer = 0;
+	shadowPitch = 0;
 	maskCache = 0;
 	maskPitch = 0;
 	matPass = 0;
@@ -74,12 +107,16 @@ Navi::Navi(Ogre::RenderWindow* renderWin, std::string name, const NaviPosition &
 }
 
 Navi::Navi(Ogre::RenderWindow* renderWin, std::string name, unsigned short width, unsigned short height,
-		   Ogre::FilterOptions texFiltering)
+		   Ogre::FilterOptions texFiltering, bool mipmaps)
 {
 	webView = 0;
 	naviName = name;
 	naviWidth = width;
 	naviHeight = height;
+	renderWidth = width;
+	renderHeight = height;
+	resolutionScale = 1;
+	lastLoadType = LoadNone;
 	winWidth = renderWin->getWidth();
 	winHeight = renderWin->getHeight();
 	renderWindow = renderWin;
@@ -89,22 +126,51 @@ Navi::Navi(Ogre::RenderWindow* renderWin, std::string name, unsigned short width
 	overlay = 0;
 	panel = 0;
 	maxUpdatePS = 0;
+	lodAnchor = 0;
+	lodFullRateDistance = 0;
+	lodMinRateDistance = 0;
+	lodFullRateCoverage = 0;
+	projectedCoverage = -1;
+	lodMinUpdatePS = 1;
 	lastUpdateTime = 0;
 	opacity = 1;
 	usingMask = false;
+	maskOpaque = false;
 	ignoringTrans = true;
 	transparent = 0.05;
 	ignoringBounds = false;
 	isMaterial = true;
 	okayToDelete = false;
 	isVisible = true;
-	fadingOut = false;
-	fadingOutStart = fadingOutEnd = 0;
-	fadingIn = false;
-	fadingInStart = fadingInEnd = 0;
+	fadeOpacity = 1;
+	appliedOpacity = -1;
+	scale = 1;
 	compensateNPOT = false;
+	usingShaders = false;
+	sharingMaterial = false;
+	compositeQuad = 0;
+	compositeNode = 0;
+	isOccluded = false;
+	awaitingRestore = false;
+	zoomPending = false;
+	textureEvicted = false;
+	needsRefresh = false;
+	lastVisibleFrame = 0;
 	texWidth = width;
 	texHeight = height;
+	maskTexWidth = width;
+	maskTexHeight = height;
+	textureName = name + "Texture";
+	texturePacked = false;
+	atlasLeft = atlasTop = atlasWidth = atlasHeight = 0;
+	texUsage = TU_DYNAMIC_WRITE_ONLY_DISCARDABLE;
+	texMipmaps = 0;
+	useMipmaps = mipmaps;
+	mipChain = 0;
+	useShadowSurface = false;
+	shadowSurface = 0;
+	shadowBuffer = 0;
+	shadowPitch = 0;
 	maskCache = 0;
 	maskPitch = 0;
 	matPass = 0;
@@ -123,6 +189,8 @@ Navi::~Navi()
 	if(maskCache)
 		delete[] maskCache;
 
+	destroyShadowSurface();
+
 	WindowEventUtilities::removeWindowEventListener(renderWindow, this);
 
 	if(webView)
@@ -135,8 +203,11 @@ Navi::~Navi()
 		OverlayManager::getSingletonPtr()->destroy(overlay);
 	}
 
-	MaterialManager::getSingletonPtr()->remove(naviName + "Material");
-	TextureManager::getSingletonPtr()->remove(naviName + "Texture");
+	if(sharingMaterial)
+		NaviManager::Get().releaseSharedMaterial(materialName);
+	else
+		MaterialManager::getSingletonPtr()->remove(materialName);
+	destroyTexture();
 	if(usingMask) TextureManager::getSingletonPtr()->remove(naviName + "MaskTexture");
 }
 
@@ -146,29 +217,41 @@ void Navi::createOverlay(unsigned short zOrder)
 
 	panel = static_cast<PanelOverlayElement*>(overlayManager.createOverlayElement("Panel", naviName + "Panel"));
 	panel->setMetricsMode(Ogre::GMM_PIXELS);
-	panel->setMaterialName(naviName + "Material");
+	panel->setMaterialName(materialName);
 	panel->setDimensions(naviWidth, naviHeight);
-	if(compensateNPOT)
-		panel->setUV(0, 0, (Real)naviWidth/(Real)texWidth, (Real)naviHeight/(Real)texHeight);	
+	if(sharingMaterial)
+		applyShaderConstants(panel);
+	if(compensateNPOT && !usingShaders)
+	{
+		Real u1, v1, u2, v2;
+		getDerivedUV(u1, v1, u2, v2);
+		panel->setUV(u1, v1, u2, v2);
+	}
 	
 	overlay = overlayManager.create(naviName + "Overlay");
 	overlay->add2D(panel);
 	overlay->setZOrder(zOrder);
 	resetPosition();
-	if(isVisible) overlay->show();
+	updateOverlayVisibility();
 }
 
 void Navi::createWebView()
 {
-	webView = Awesomium::WebCore::Get().createWebView(naviWidth, naviHeight);
+	webView = Awesomium::WebCore::Get().createWebView(renderWidth, renderHeight);
 	webView->setListener(this);
+	webView->setCallback("NaviImageRegions");
 }
 
-void Navi::createMaterial(Ogre::FilterOptions texFiltering)
+void Navi::createTexture()
 {
-	limit<float>(opacity, 0, 1);
+	texWidth = renderWidth;
+	texHeight = renderHeight;
+	compensateNPOT = false;
+	texturePacked = false;
+	textureEvicted = false;
+	textureName = naviName + "Texture";
 
-	if(!Bitwise::isPO2(naviWidth) || !Bitwise::isPO2(naviHeight))
+	if(!Bitwise::isPO2(renderWidth) || !Bitwise::isPO2(renderHeight))
 	{
 		if(Root::getSingleton().getRenderSystem()->getCapabilities()->hasCapability(RSC_NON_POWER_OF_2_TEXTURES))
 		{
@@ -179,40 +262,235 @@ void Navi::createMaterial(Ogre::FilterOptions texFiltering)
 		
 		if(compensateNPOT)
 		{
-			texWidth = Bitwise::firstPO2From(naviWidth);
-			texHeight = Bitwise::firstPO2From(naviHeight);
+			texWidth = Bitwise::firstPO2From(renderWidth);
+			texHeight = Bitwise::firstPO2From(renderHeight);
 		}
 	}
 
-	// Create the texture
+	maskTexWidth = texWidth;
+	maskTexHeight = texHeight;
+
+	texUsage = TU_DYNAMIC_WRITE_ONLY_DISCARDABLE;
+	texMipmaps = 0;
+
+	// Rather than padding an NPOT Navi out to the next power of two, try to share a texture page with other Navis
+	if(compensateNPOT && !isMaterial && !useMipmaps && 
+		NaviManager::Get().allocateTextureRect(renderWidth, renderHeight, textureName, atlasLeft, atlasTop, atlasWidth, atlasHeight))
+	{
+		texturePacked = true;
+
+		TexturePtr texture = TextureManager::getSingleton().getByName(textureName);
+		texWidth = (unsigned short)texture->getWidth();
+		texHeight = (unsigned short)texture->getHeight();
+		texUsage = texture->getUsage();
+
+		HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
+		const PixelBox& pixelBox = pixelBuffer->lock(Box(atlasLeft, atlasTop, atlasLeft + atlasWidth, atlasTop + atlasHeight), 
+			HardwareBuffer::HBL_NORMAL);
+		texFormat = pixelBox.format;
+		texDepth = Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
+		texPitch = (pixelBox.rowPitch*texDepth);
+
+		uint8* pDest = static_cast<uint8*>(pixelBox.data);
+
+		for(unsigned int row = 0; row < atlasHeight; row++)
+			memset(pDest + row * texPitch, 128, atlasWidth * texDepth);
+
+		pixelBuffer->unlock();
+
+		return;
+	}
+
+	// Create the texture, preferably letting the hardware maintain the mip chain
+	if(useMipmaps && Root::getSingleton().getRenderSystem()->getCapabilities()->hasCapability(RSC_AUTOMIPMAP))
+	{
+		texUsage = TU_DYNAMIC_WRITE_ONLY_DISCARDABLE | TU_AUTOMIPMAP;
+		texMipmaps = MIP_UNLIMITED;
+	}
+
 	TexturePtr texture = TextureManager::getSingleton().createManual(
-		naviName + "Texture", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-		TEX_TYPE_2D, texWidth, texHeight, 0, PF_BYTE_BGR,
-		TU_DYNAMIC_WRITE_ONLY_DISCARDABLE, this);
+		textureName, ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+		TEX_TYPE_2D, texWidth, texHeight, (int)texMipmaps, PF_BYTE_BGR,
+		texUsage, this);
+
+	if(useMipmaps && !texture->getMipmapsHardwareGenerated())
+	{
+		// Not available for this format/usage, we'll box-filter the mip chain ourselves
+		TextureManager::getSingleton().remove(textureName);
+
+		texUsage = TU_DYNAMIC_WRITE_ONLY_DISCARDABLE;
+		createMipChain();
+
+		texture = TextureManager::getSingleton().createManual(
+			textureName, ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+			TEX_TYPE_2D, texWidth, texHeight, (int)texMipmaps, PF_BYTE_BGR,
+			texUsage, this);
+	}
 
 	HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
 	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
 	const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+	texFormat = pixelBox.format;
 	texDepth = Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
 	texPitch = (pixelBox.rowPitch*texDepth);
 
 	uint8* pDest = static_cast<uint8*>(pixelBox.data);
 
-	memset(pDest, 128, texHeight*texPitch);
+	// Only the used area (plus a one texel border for filtering) is ever sampled
+	size_t clearHeight = std::min(renderHeight + 1, (int)texHeight);
+	size_t clearSpan = std::min(renderWidth + 1, (int)texWidth) * texDepth;
+
+	for(size_t row = 0; row < clearHeight; row++)
+		memset(pDest + row * texPitch, 128, clearSpan);
 
 	pixelBuffer->unlock();
 
-	MaterialPtr material = MaterialManager::getSingleton().create(naviName + "Material", 
+	if(mipChain)
+		uploadMipChain(0, 0, texWidth, texHeight);
+}
+
+void Navi::destroyTexture()
+{
+	if(texturePacked)
+		NaviManager::Get().releaseTextureRect(textureName, atlasLeft, atlasTop, atlasWidth, atlasHeight);
+	else
+		TextureManager::getSingleton().remove(textureName);
+
+	texturePacked = false;
+	atlasLeft = atlasTop = atlasWidth = atlasHeight = 0;
+
+	if(mipChain)
+	{
+		delete[] mipChain;
+		mipChain = 0;
+	}
+}
+
+void Navi::updateTextureRects()
+{
+	Real u1, v1, u2, v2;
+	getDerivedUV(u1, v1, u2, v2);
+
+	if(usingShaders)
+	{
+		Vector4 baseRect(0, 0, (Real)renderWidth/(Real)texWidth, (Real)renderHeight/(Real)texHeight);
+		if(texturePacked)
+			baseRect = Vector4((Real)atlasLeft/(Real)texWidth, (Real)atlasTop/(Real)texHeight, baseRect.z, baseRect.w);
+
+		setShaderConstant(ShaderBaseRect, baseRect);
+		setShaderConstant(ShaderMaskRect, Vector4(0, 0, (Real)renderWidth/(Real)maskTexWidth, (Real)renderHeight/(Real)maskTexHeight));
+		return;
+	}
+
+	if(panel)
+		panel->setUV(u1, v1, u2, v2);
+
+	if(maskTexUnit)
+	{
+		// The mask texture isn't packed: map the Navi's area of the texture page onto it
+		Real scaleU = ((Real)renderWidth/(Real)maskTexWidth) / (u2 - u1);
+		Real scaleV = ((Real)renderHeight/(Real)maskTexHeight) / (v2 - v1);
+
+		Matrix4 maskTransform = Matrix4::IDENTITY;
+		maskTransform[0][0] = scaleU;
+		maskTransform[0][3] = -u1 * scaleU;
+		maskTransform[1][1] = scaleV;
+		maskTransform[1][3] = -v1 * scaleV;
+		maskTexUnit->setTextureTransform(maskTransform);
+		NaviManager::Get().frameStats.materialStateChanges++;
+	}
+}
+
+void Navi::createMaterial(Ogre::FilterOptions texFiltering)
+{
+	limit<float>(opacity, 0, 1);
+
+	createTexture();
+
+	const std::string& programName = NaviManager::Get().getShaderProgram();
+	usingShaders = !programName.empty();
+
+	// Overlay Navis only differ by their textures and shader constants, those on the same texture page share a material
+	if(usingShaders && !isMaterial)
+	{
+		sharingMaterial = true;
+		bindSharedMaterial();
+		updateTextureRects();
+		applyOpacity();
+		return;
+	}
+
+	materialName = naviName + "Material";
+	MaterialPtr material = MaterialManager::getSingleton().create(materialName, 
 		ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
 	matPass = material->getTechnique(0)->getPass(0);
 	matPass->setSceneBlending(SBT_TRANSPARENT_ALPHA);
 	matPass->setDepthWriteEnabled(false);
 
-	baseTexUnit = matPass->createTextureUnitState(naviName + "Texture");
+	baseTexUnit = matPass->createTextureUnitState(textureName);
 	
-	baseTexUnit->setTextureFiltering(texFiltering, texFiltering, FO_NONE);
+	baseTexUnit->setTextureFiltering(texFiltering, texFiltering, useMipmaps ? FO_LINEAR : FO_NONE);
 	if(texFiltering == FO_ANISOTROPIC)
 		baseTexUnit->setTextureAnisotropy(4);
+
+	NaviManager::Get().frameStats.materialStateChanges++;
+
+	if(usingShaders)
+	{
+		matPass->setFragmentProgram(programName);
+
+		maskTexUnit = matPass->createTextureUnitState("NaviWhiteMaskTexture");
+		maskTexUnit->setTextureFiltering(FO_NONE, FO_NONE, FO_NONE);
+
+		updateTextureRects();
+	}
+
+	applyOpacity();
+}
+
+void Navi::bindSharedMaterial()
+{
+	NaviManager& manager = NaviManager::Get();
+
+	// Acquire before releasing so that rebinding to the same material doesn't destroy it
+	std::string previousName = materialName;
+	materialName = manager.acquireSharedMaterial(textureName, usingMask ? naviName + "MaskTexture" : "NaviWhiteMaskTexture");
+	if(!previousName.empty())
+		manager.releaseSharedMaterial(previousName);
+
+	MaterialPtr material = MaterialManager::getSingleton().getByName(materialName);
+	matPass = material->getTechnique(0)->getPass(0);
+
+	if(panel)
+		panel->setMaterialName(materialName);
+	if(compositeQuad)
+		compositeQuad->getSection(0)->setMaterialName(materialName);
+
+	manager.frameStats.materialStateChanges++;
+}
+
+void Navi::setShaderConstant(ShaderConstant constant, const Ogre::Vector4& value)
+{
+	static const char* constantNames[ShaderConstantCount] = { "naviParams", "baseRect", "maskRect" };
+
+	if(!sharingMaterial)
+	{
+		matPass->getFragmentProgramParameters()->setNamedConstant(constantNames[constant], value);
+		return;
+	}
+
+	shaderConstants[constant] = value;
+
+	if(panel)
+		panel->setCustomParameter(constant, value);
+	if(compositeQuad)
+		compositeQuad->getSection(0)->setCustomParameter(constant, value);
+}
+
+void Navi::applyShaderConstants(Ogre::Renderable* renderable) const
+{
+	for(int i = 0; i < ShaderConstantCount; i++)
+		renderable->setCustomParameter(i, shaderConstants[i]);
 }
 
 // This is for when the rendering device has a hiccup and loses the dynamic texture
@@ -223,60 +501,631 @@ void Navi::loadResource(Resource* resource)
 	tex->setTextureType(TEX_TYPE_2D);
 	tex->setWidth(texWidth);
 	tex->setHeight(texHeight);
-	tex->setNumMipmaps(0);
+	tex->setNumMipmaps(texMipmaps);
 	tex->setFormat(PF_BYTE_BGR);
-	tex->setUsage(TU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+	tex->setUsage(texUsage);
 	tex->createInternalResources();
 
-	// force update
+	// We still have a copy of the mip chain, nothing else to do
+	if(mipChain)
+	{
+		uploadMipChain(0, 0, texWidth, texHeight);
+		return;
+	}
+
+	if(shadowSurface)
+	{
+		uploadShadowSurface(0, 0, renderWidth, renderHeight);
+		return;
+	}
+
+	// Nothing to restore if we haven't rendered anything yet (the texture is being loaded for the first time)
+	if(!lastUpdateTime)
+		return;
+
+	// The contents are undefined: hide until NaviManager schedules a re-render (see NaviManager::scheduleRestores)
+	HardwarePixelBufferSharedPtr pixelBuffer = tex->getBuffer();
+	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
+	const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+
+	uint8* pDest = static_cast<uint8*>(pixelBox.data);
+	for(unsigned int row = 0; row < renderHeight; row++)
+		memset(pDest + row * texPitch, 128, renderWidth * texDepth);
+
+	pixelBuffer->unlock();
+
+	beginRestore();
+}
+
+void Navi::beginRestore()
+{
+	awaitingRestore = true;
+	updateOverlayVisibility();
+	NaviManager::Get().compositeDirty = true;
+}
+
+void Navi::createMipChain()
+{
+	size_t offset = 0;
+	size_t width = texWidth;
+	size_t height = texHeight;
+
+	mipOffsets.clear();
+
+	while(true)
+	{
+		mipOffsets.push_back(offset);
+		offset += width * height * 4;
+
+		if(width == 1 && height == 1)
+			break;
+
+		width = std::max<size_t>(width / 2, 1);
+		height = std::max<size_t>(height / 2, 1);
+	}
+
+	texMipmaps = mipOffsets.size() - 1;
+	mipChain = new unsigned char[offset];
+	memset(mipChain, 128, offset);
+}
+
+void Navi::uploadMipChain(size_t left, size_t top, size_t right, size_t bottom)
+{
+	TexturePtr texture = TextureManager::getSingleton().getByName(textureName);
+
+	size_t width = texWidth;
+	size_t height = texHeight;
+
+	for(size_t level = 0; level < mipOffsets.size(); level++)
+	{
+		if(level)
+		{
+			size_t srcWidth = width;
+			size_t srcHeight = height;
+
+			width = std::max<size_t>(width / 2, 1);
+			height = std::max<size_t>(height / 2, 1);
+
+			// The changed region of the larger level, rounded outwards to whole destination texels
+			left = std::min(left / 2, width - 1);
+			top = std::min(top / 2, height - 1);
+			right = std::min((right + 1) / 2, width);
+			bottom = std::min((bottom + 1) / 2, height);
+
+			downsampleBGRA(mipChain + mipOffsets[level - 1], srcWidth, srcHeight, 
+				mipChain + mipOffsets[level], width, left, top, right, bottom);
+		}
+
+		blitToTexture(texture->getBuffer(0, level), mipChain + mipOffsets[level], width, Box(left, top, right, bottom), left, top);
+	}
+}
+
+void Navi::createShadowSurface()
+{
+	destroyShadowSurface();
+
+	// The first level of the mip chain already is a copy of our pixels
+	if(!useShadowSurface || mipChain)
+		return;
+
+	// Page-aligned, with cache-line aligned rows: the surface is handed to the render system as-is
+	shadowPitch = (renderWidth * 4 + 63) & ~(size_t)63;
+	shadowBuffer = new unsigned char[shadowPitch * renderHeight + 4095];
+	shadowSurface = shadowBuffer + ((4096 - ((size_t)shadowBuffer & 4095)) & 4095);
+	memset(shadowSurface, 128, shadowPitch * renderHeight);
+
+	needsRefresh = true;
+}
+
+void Navi::destroyShadowSurface()
+{
+	if(shadowBuffer)
+		delete[] shadowBuffer;
+
+	shadowBuffer = 0;
+	shadowSurface = 0;
+}
+
+void Navi::uploadShadowSurface(size_t left, size_t top, size_t right, size_t bottom)
+{
+	TexturePtr texture = TextureManager::getSingleton().getByName(textureName);
+
+	size_t offsetX = texturePacked ? atlasLeft : 0;
+	size_t offsetY = texturePacked ? atlasTop : 0;
+
+	blitToTexture(texture->getBuffer(), shadowSurface, shadowPitch / 4, Box(left, top, right, bottom), offsetX + left, offsetY + top);
+}
+
+void Navi::blitToTexture(const HardwarePixelBufferSharedPtr& pixelBuffer, const unsigned char* src, size_t srcRowPitch, 
+						 const Box& srcRect, size_t destLeft, size_t destTop)
+{
+	size_t width = srcRect.getWidth();
+	size_t height = srcRect.getHeight();
+	Box destRect(destLeft, destTop, destLeft + width, destTop + height);
+
+	if(texFormat == PF_BYTE_BGR && texDepth == 3)
+	{
+		// Drop the alpha channel ourselves, the render system then only has to copy rows
+		packBuffer.resize(width * height * 3);
+
+		for(size_t row = 0; row < height; row++)
+			packBGRAtoBGR(src + ((srcRect.top + row) * srcRowPitch + srcRect.left) * 4, &packBuffer[row * width * 3], width);
+
+		pixelBuffer->blitFromMemory(PixelBox(width, height, 1, PF_BYTE_BGR, &packBuffer[0]), destRect);
+		return;
+	}
+
+	// When the texture is 32-bit after all (most Direct3D devices), describe the source in its exact format so
+	// that the render system can copy rows without converting any pixels
+	PixelFormat srcFormat = PF_BYTE_BGRA;
+	if(texFormat == PF_X8R8G8B8 || texFormat == PF_A8R8G8B8)
+		srcFormat = texFormat;
+
+	PixelBox srcBox(srcRect, srcFormat, (void*)src);
+	srcBox.rowPitch = srcRowPitch;
+	srcBox.slicePitch = srcRowPitch * srcRect.bottom;
+
+	pixelBuffer->blitFromMemory(srcBox, destRect);
+}
+
+namespace
+{
+	void uniteRect(Box& rect, const Box& other)
+	{
+		if(!rect.getWidth() || !rect.getHeight())
+		{
+			rect = other;
+			return;
+		}
+
+		rect.left = std::min(rect.left, other.left);
+		rect.top = std::min(rect.top, other.top);
+		rect.right = std::max(rect.right, other.right);
+		rect.bottom = std::max(rect.bottom, other.bottom);
+	}
+}
+
+bool Navi::getImageRect(const NaviImage& image, Box& rect) const
+{
+	if(!image.hasRegion || image.pixels.empty())
+		return false;
+
+	int left = std::max(image.regionLeft, 0);
+	int top = std::max(image.regionTop, 0);
+	int right = std::min(image.regionLeft + image.regionWidth, (int)renderWidth);
+	int bottom = std::min(image.regionTop + image.regionHeight, (int)renderHeight);
+
+	if(left >= right || top >= bottom)
+		return false;
+
+	rect = Box(left, top, right, bottom);
+	return true;
+}
+
+bool Navi::getImagesRect(Box& rect) const
+{
+	rect = Box();
+
+	for(std::map<std::string, NaviImage>::const_iterator i = imageMap.begin(); i != imageMap.end(); ++i)
+	{
+		Box imageRect;
+
+		if(getImageRect(i->second, imageRect))
+			uniteRect(rect, imageRect);
+	}
+
+	return rect.getWidth() && rect.getHeight();
+}
+
+void Navi::scaleImage(NaviImage& image)
+{
+	if(!image.hasRegion || image.pixels.empty() || (image.regionWidth == image.width && image.regionHeight == image.height))
+	{
+		std::vector<unsigned char>().swap(image.scaled);
+		return;
+	}
+
+	image.scaled.resize((size_t)image.regionWidth * image.regionHeight * 4);
+	scaleBGRA(&image.pixels[0], image.width, image.height, image.width * 4, &image.scaled[0], image.regionWidth, image.regionHeight);
+}
+
+void Navi::invalidateImage(const NaviImage& image)
+{
+	Box rect;
+
+	if(getImageRect(image, rect))
+		uniteRect(dirtyImageRect, rect);
+}
+
+void Navi::drawImages(unsigned char* dest, size_t destPitch, size_t destDepth, const Box& rect)
+{
+	// 'dest' points at the top-left pixel of 'rect'
+
+	for(std::map<std::string, NaviImage>::const_iterator i = imageMap.begin(); i != imageMap.end(); ++i)
+	{
+		const NaviImage& image = i->second;
+		Box imageRect;
+
+		if(!getImageRect(image, imageRect))
+			continue;
+
+		size_t left = std::max(imageRect.left, rect.left);
+		size_t top = std::max(imageRect.top, rect.top);
+		size_t right = std::min(imageRect.right, rect.right);
+		size_t bottom = std::min(imageRect.bottom, rect.bottom);
+
+		if(left >= right || top >= bottom)
+			continue;
+
+		const unsigned char* src = image.scaled.empty() ? &image.pixels[0] : &image.scaled[0];
+		size_t srcPitch = (image.scaled.empty() ? image.width : image.regionWidth) * 4;
+		src += ((int)top - image.regionTop) * srcPitch + ((int)left - image.regionLeft) * 4;
+
+		for(size_t row = top; row < bottom; row++, src += srcPitch)
+		{
+			unsigned char* destRow = dest + (row - rect.top) * destPitch + (left - rect.left) * destDepth;
+
+			if(destDepth == 4)
+				memcpy(destRow, src, (right - left) * 4);
+			else
+				packBGRAtoBGR(src, destRow, right - left);
+		}
+	}
+}
+
+void Navi::updateImageRegions(const std::string& regions)
+{
+	// Each region is reported as "name,left,top,width,height", separated by ';'
+	std::vector<std::pair<std::string, NaviImage> > reported;
+	Splitter entries(regions, ";");
+	StringRef entry;
+
+	while(entries.next(entry))
+	{
+		Splitter fields(entry, ",", false);
+		StringRef name, field;
+		int values[4];
+		int count = 0;
+
+		if(!fields.next(name) || name.empty())
+			continue;
+
+		while(count < 4 && fields.next(field) && parseNumber(field.data(), values[count]))
+			count++;
+
+		if(count < 4 || values[2] <= 0 || values[3] <= 0)
+			continue;
+
+		NaviImage region;
+		region.hasRegion = true;
+		region.regionLeft = values[0];
+		region.regionTop = values[1];
+		region.regionWidth = values[2];
+		region.regionHeight = values[3];
+		reported.push_back(std::make_pair(name.str(), region));
+	}
+
+	for(std::map<std::string, NaviImage>::iterator i = imageMap.begin(); i != imageMap.end(); ++i)
+	{
+		NaviImage& image = i->second;
+		NaviImage region;
+
+		for(size_t j = 0; j < reported.size(); j++)
+		{
+			if(reported[j].first == i->first)
+			{
+				region = reported[j].second;
+				break;
+			}
+		}
+
+		if(region.hasRegion == image.hasRegion && (!region.hasRegion || (region.regionLeft == image.regionLeft && 
+			region.regionTop == image.regionTop && region.regionWidth == image.regionWidth && region.regionHeight == image.regionHeight)))
+			continue;
+
+		// The page has to be rendered again where the image used to be drawn
+		Box rect;
+		if(getImageRect(image, rect))
+			needsRefresh = true;
+
+		image.hasRegion = region.hasRegion;
+		image.regionLeft = region.regionLeft;
+		image.regionTop = region.regionTop;
+		image.regionWidth = region.regionWidth;
+		image.regionHeight = region.regionHeight;
+
+		scaleImage(image);
+		invalidateImage(image);
+	}
+
+	// Remember the regions of images that haven't been set yet
+	for(size_t j = 0; j < reported.size(); j++)
+		if(imageMap.find(reported[j].first) == imageMap.end())
+			imageMap[reported[j].first] = reported[j].second;
+}
+
+void Navi::update()
+{
+	bool showing = isShowing();
+
+	if(showing)
+	{
+		lastVisibleFrame = NaviManager::Get().frameCounter;
+
+		if(textureEvicted)
+			restoreTexture();
+	}
+
+	unsigned int updateRate = getUpdateRate();
+	if(updateRate && !needsRefresh)
+		if(timer.getMilliseconds() - lastUpdateTime < 1000 / updateRate)
+			return;
+
+	bool imagesDirty = dirtyImageRect.getWidth() && dirtyImageRect.getHeight();
+
+	if(!webView->isDirty() && !needsRefresh && !imagesDirty)
+		return;
+
+	// Nothing of us can be seen: leave the WebView dirty, it'll be rendered once we're visible again
+	if(!showing)
+	{
+		NaviManager::Get().frameStats.suppressedUpdates++;
+		return;
+	}
+
+	// Don't show a page laid out for the reduced viewport, wait until it has been zoomed (see Navi::applyZoom)
+	if(zoomPending)
+		return;
+
+	// The WebView stays dirty while we're covered, we'll catch up as soon as we're uncovered
+	if(isOccluded)
+	{
+		NaviManager::Get().frameStats.culledUploads++;
+		return;
+	}
+
+	if(mipChain || shadowSurface)
+	{
+		unsigned char* surface = mipChain ? mipChain : shadowSurface;
+		size_t surfacePitch = mipChain ? texWidth * 4 : shadowPitch;
+
+		// When only images changed, the page itself doesn't have to be rendered again
+		Box dirty = dirtyImageRect;
+
+		if(webView->isDirty() || needsRefresh)
+		{
+			Awesomium::Rect changed;
+			webView->render(surface, (int)surfacePitch, 4, &changed);
+
+			if(changed.isEmpty() || needsRefresh)
+				dirty = Box(0, 0, renderWidth, renderHeight);
+			else
+				uniteRect(dirty, Box(changed.x, changed.y, changed.x + changed.width, changed.y + changed.height));
+
+			// Rendering overwrites the whole surface, every image has to be drawn (and uploaded) again
+			Box imagesRect;
+			if(getImagesRect(imagesRect))
+			{
+				drawImages(surface, surfacePitch, 4, Box(0, 0, renderWidth, renderHeight));
+				uniteRect(dirty, imagesRect);
+			}
+		}
+		else
+			drawImages(surface + dirty.top * surfacePitch + dirty.left * 4, surfacePitch, 4, dirty);
+
+		if(mipChain)
+			uploadMipChain(dirty.left, dirty.top, dirty.right, dirty.bottom);
+		else
+			uploadShadowSurface(dirty.left, dirty.top, dirty.right, dirty.bottom);
+	}
+	else
+	{
+		TexturePtr texture = TextureManager::getSingleton().getByName(textureName);
+		
+		HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
+
+		if(webView->isDirty() || needsRefresh)
+		{
+			if(texturePacked)
+				pixelBuffer->lock(Box(atlasLeft, atlasTop, atlasLeft + renderWidth, atlasTop + renderHeight), HardwareBuffer::HBL_NORMAL);
+			else
+				pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
+			const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+
+			uint8* destBuffer = static_cast<uint8*>(pixelBox.data);
+
+			webView->render(destBuffer, (int)texPitch, (int)texDepth);
+			drawImages(destBuffer, texPitch, texDepth, Box(0, 0, renderWidth, renderHeight));
+		}
+		else
+		{
+			// Only images changed: the rest of the texture still holds the page, just lock what they cover
+			const Box& dirty = dirtyImageRect;
+			size_t offsetX = texturePacked ? atlasLeft : 0;
+			size_t offsetY = texturePacked ? atlasTop : 0;
+			pixelBuffer->lock(Box(offsetX + dirty.left, offsetY + dirty.top, offsetX + dirty.right, offsetY + dirty.bottom), 
+				HardwareBuffer::HBL_NORMAL);
+
+			drawImages(static_cast<uint8*>(pixelBuffer->getCurrentLock().data), texPitch, texDepth, dirty);
+		}
+
+		pixelBuffer->unlock();
+	}
+
+	NaviManager::Get().compositeDirty = true;
+	needsRefresh = false;
+	dirtyImageRect = Box();
+
+	if(awaitingRestore)
+	{
+		awaitingRestore = false;
+		updateOverlayVisibility();
+		NaviManager::Get().frameStats.restoredNavis++;
+	}
+
+	lastUpdateTime = timer.getMilliseconds();
+}
+
+void Navi::evictTexture()
+{
+	// Our material still refers to the texture, make sure its memory is actually released
+	if(!texturePacked)
+		TextureManager::getSingleton().getByName(textureName)->unload();
+
+	destroyTexture();
+	textureEvicted = true;
+
+	destroyShadowSurface();
+}
+
+void Navi::restoreTexture()
+{
+	createTexture();
+	if(sharingMaterial)
+	{
+		bindSharedMaterial();
+	}
+	else
+	{
+		baseTexUnit->setTextureName(textureName);
+		NaviManager::Get().frameStats.materialStateChanges++;
+	}
+
+	updateTextureRects();
+	createShadowSurface();
+
+	needsRefresh = true;
+	NaviManager::Get().compositeDirty = true;
+}
+
+void Navi::applyOpacity()
+{
+	float effectiveOpacity = opacity * fadeOpacity;
+
+	if(effectiveOpacity == appliedOpacity)
+		return;
+
+	if(usingShaders)
+	{
+		setShaderConstant(ShaderNaviParams, Vector4(effectiveOpacity, 0, 0, 0));
+	}
+	else
+	{
+		baseTexUnit->setAlphaOperation(LBX_SOURCE1, LBS_MANUAL, LBS_CURRENT, effectiveOpacity);
+		NaviManager::Get().frameStats.materialStateChanges++;
+	}
+
+	appliedOpacity = effectiveOpacity;
+	NaviManager::Get().compositeDirty = true;
+}
+
+bool Navi::isOpaque() const
+{
+	return !isMaterial && isVisible && !awaitingRestore && opacity * fadeOpacity >= 1 && (!usingMask || maskOpaque);
+}
+
+bool Navi::isShowing() const
+{
+	return isVisible && opacity * fadeOpacity > 0 && isOnScreen();
 }
 
-void Navi::update()
+bool Navi::isOnScreen() const
 {
-	if(maxUpdatePS)
-		if(timer.getMilliseconds() - lastUpdateTime < 1000 / maxUpdatePS)
-			return;
+	if(isMaterial)
+		return true;
 
-	Ogre::Real fadeMod = 1;
-	
-	if(fadingIn)
-	{
-		if(fadingInEnd < timer.getMilliseconds())
-			fadingInStart = fadingInEnd = fadingIn = 0;
-		else
-			fadeMod = (float)(timer.getMilliseconds() - fadingInStart) / (float)(fadingInEnd - fadingInStart);
-	} 
-	else if(fadingOut)
-	{
-		if(fadingOutEnd < timer.getMilliseconds())
-		{
-			fadingOutStart = fadingOutEnd = fadeMod = fadingOut = isVisible = 0;
+	return panel->getLeft() < renderWindow->getWidth() && panel->getLeft() + panel->getWidth() > 0 &&
+		panel->getTop() < renderWindow->getHeight() && panel->getTop() + panel->getHeight() > 0;
+}
 
-			if(!isMaterial)
-				overlay->hide();
-		}
-		else
-			fadeMod = 1 - (float)(timer.getMilliseconds() - fadingOutStart) / (float)(fadingOutEnd - fadingOutStart);
-	}
+void Navi::updateOverlayVisibility()
+{
+	if(isMaterial)
+		return;
 
-	baseTexUnit->setAlphaOperation(LBX_SOURCE1, LBS_MANUAL, LBS_CURRENT, fadeMod * opacity);
+	if(isVisible && !awaitingRestore && !NaviManager::Get().compositing)
+		overlay->show();
+	else
+		overlay->hide();
+}
 
-	if(!webView->isDirty())
+void Navi::updateCompositeQuad(unsigned int layerWidth, unsigned int layerHeight)
+{
+	if(!compositeQuad)
 		return;
 
-	TexturePtr texture = TextureManager::getSingleton().getByName(naviName + "Texture");
-	
-	HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
-	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
-	const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
-
-	uint8* destBuffer = static_cast<uint8*>(pixelBox.data);
+	compositeNode->setVisible(isVisible && !awaitingRestore);
 
-	webView->render(destBuffer, (int)texPitch, (int)texDepth);
+	if(!isVisible || awaitingRestore)
+		return;
 
-	pixelBuffer->unlock();
+	RenderSystem* renderSystem = Root::getSingleton().getRenderSystem();
+
+	// The composite camera is orthographic and centered on the layer, one unit per pixel
+	Real left = panel->getLeft() - layerWidth / 2.0f + renderSystem->getHorizontalTexelOffset();
+	Real top = layerHeight / 2.0f - panel->getTop() - renderSystem->getVerticalTexelOffset();
+	Real right = left + panel->getWidth();
+	Real bottom = top - panel->getHeight();
+
+	Real u1, v1, u2, v2;
+	getDerivedUV(u1, v1, u2, v2);
+
+	compositeQuad->beginUpdate(0);
+	compositeQuad->position(left, top, 0);
+	compositeQuad->textureCoord(u1, v1);
+	compositeQuad->position(left, bottom, 0);
+	compositeQuad->textureCoord(u1, v2);
+	compositeQuad->position(right, bottom, 0);
+	compositeQuad->textureCoord(u2, v2);
+	compositeQuad->position(right, top, 0);
+	compositeQuad->textureCoord(u2, v1);
+	compositeQuad->quad(0, 1, 2, 3);
+	compositeQuad->end();
+
+	// Depth is only used to sort the (transparent) quads back-to-front by Z-Order
+	compositeNode->setPosition(0, 0, (Real)overlay->getZOrder() - 1000);
+}
 
-	lastUpdateTime = timer.getMilliseconds();
+void Navi::applyTween(NaviManager::TweenProperty property, float valueA, float valueB, bool finished)
+{
+	switch(property)
+	{
+	case NaviManager::TweenOpacity:
+		opacity = valueA;
+		applyOpacity();
+		break;
+	case NaviManager::TweenFade:
+		fadeOpacity = valueA;
+		applyOpacity();
+
+		if(finished && fadeOpacity == 0)
+		{
+			isVisible = false;
+			updateOverlayVisibility();
+			NaviManager::Get().compositeDirty = true;
+		}
+		break;
+	case NaviManager::TweenPosition:
+		{
+			int left = (int)(valueA < 0 ? valueA - 0.5f : valueA + 0.5f);
+			int top = (int)(valueB < 0 ? valueB - 0.5f : valueB + 0.5f);
+
+			if(left != (int)panel->getLeft() || top != (int)panel->getTop())
+			{
+				panel->setPosition(left, top);
+				NaviManager::Get().compositeDirty = true;
+			}
+		}
+		break;
+	case NaviManager::TweenScale:
+		if(valueA != scale)
+		{
+			scale = valueA;
+			panel->setDimensions(naviWidth * scale, naviHeight * scale);
+			NaviManager::Get().compositeDirty = true;
+		}
+		break;
+	}
 }
 
 bool Navi::isPointOverMe(int x, int y)
@@ -288,7 +1137,7 @@ bool Navi::isPointOverMe(int x, int y)
 	if(panel->getLeft() < x && x < (panel->getLeft()+panel->getWidth()))
 		if(panel->getTop() < y && y < (panel->getTop()+panel->getHeight()))
 			return !ignoringTrans || !maskCache ? true : 
-				maskCache[getRelativeY(y)*maskPitch+getRelativeX(x)*1+(1-1)] > 255*transparent;
+				maskCache[toRenderY(getRelativeY(y))*maskPitch+toRenderX(getRelativeX(x))*1+(1-1)] > 255*transparent;
 
 	return false;
 }
@@ -310,16 +1159,31 @@ void Navi::windowFocusChange(RenderWindow* rw)
 
 void Navi::loadURL(const std::string& url)
 {
+	lastLoadType = LoadURL;
+	lastLoad = url;
+
 	webView->loadURL(url);
 }
 
 void Navi::loadFile(const std::string& file)
 {
-	webView->loadFile(file);
+	lastLoadType = LoadFile;
+	lastLoad = file;
+
+	// Pages in the resource cache are loaded from memory, see NaviManager::preloadResources
+	const std::string* page = NaviManager::Get().getCachedPage(file);
+
+	if(page)
+		webView->loadHTML(*page);
+	else
+		webView->loadFile(file);
 }
 
 void Navi::loadHTML(const std::string& html)
 {
+	lastLoadType = LoadHTML;
+	lastLoad = html;
+
 	webView->loadHTML(html);
 }
 
@@ -337,6 +1201,8 @@ void Navi::setCallback(const std::string& name, const NaviDelegate& callback)
 
 void Navi::setProperty(const std::string& name, const Awesomium::JSValue& value)
 {
+	propertyMap[name] = value;
+
 	webView->setProperty(name, value);
 }
 
@@ -358,10 +1224,22 @@ void Navi::setMask(std::string maskFileName, std::string groupName)
 {
 	if(usingMask)
 	{
-		if(maskTexUnit)
+		if(sharingMaterial)
+		{
+			// Rebind before the old mask texture is removed from under the material
+			usingMask = false;
+			bindSharedMaterial();
+		}
+		else if(usingShaders)
+		{
+			maskTexUnit->setTextureName("NaviWhiteMaskTexture");
+			NaviManager::Get().frameStats.materialStateChanges++;
+		}
+		else if(maskTexUnit)
 		{
 			matPass->removeTextureUnitState(1);
 			maskTexUnit = 0;
+			NaviManager::Get().frameStats.materialStateChanges++;
 		}
 
 		if(!TextureManager::getSingleton().getByName(naviName + "MaskTexture").isNull())
@@ -374,13 +1252,18 @@ void Navi::setMask(std::string maskFileName, std::string groupName)
 		maskCache = 0;
 	}
 
+	maskOpaque = false;
+	maskName = maskFileName;
+	maskGroup = groupName;
+
 	if(maskFileName == "")
 	{
 		usingMask = false;
+		NaviManager::Get().compositeDirty = true;
 		return;
 	}
 
-	if(!maskTexUnit)
+	if(!maskTexUnit && !usingShaders)
 	{
 		maskTexUnit = matPass->createTextureUnitState();
 		maskTexUnit->setIsAlpha(true);
@@ -400,13 +1283,34 @@ void Navi::setMask(std::string maskFileName, std::string groupName)
 		size_t dstBpp = Ogre::PixelUtil::getNumElemBytes(Ogre::PF_BYTE_A);
 		conversionBuf = new unsigned char[srcImage.getWidth() * srcImage.getHeight() * dstBpp];
 		Ogre::PixelBox convPixels(Ogre::Box(0, 0, srcImage.getWidth(), srcImage.getHeight()), Ogre::PF_BYTE_A, conversionBuf);
-		Ogre::PixelUtil::bulkPixelConversion(srcImage.getPixelBox(), convPixels);
+
+		if(srcImage.getFormat() == Ogre::PF_BYTE_BGRA || srcImage.getFormat() == Ogre::PF_BYTE_RGBA)
+		{
+			for(size_t row = 0; row < srcImage.getHeight(); row++)
+				extractAlpha((unsigned char*)srcPixels.data + row * srcPixels.rowPitch * 4, conversionBuf + row * srcImage.getWidth(), 
+					srcImage.getWidth());
+		}
+		else
+			Ogre::PixelUtil::bulkPixelConversion(srcImage.getPixelBox(), convPixels);
+
 		srcPixels = convPixels;
 	}
 
+	unsigned char* scaledBuf = 0;
+
+	if(renderWidth != naviWidth || renderHeight != naviHeight)
+	{
+		// The mask is authored at the Navi's size, resample it to the internal resolution
+		scaledBuf = new unsigned char[renderWidth * renderHeight];
+		Ogre::PixelBox scaledPixels(Ogre::Box(0, 0, renderWidth, renderHeight), Ogre::PF_BYTE_A, scaledBuf);
+		Ogre::Box maskArea(0, 0, std::min<size_t>(naviWidth, srcPixels.getWidth()), std::min<size_t>(naviHeight, srcPixels.getHeight()));
+		Image::scale(srcPixels.getSubVolume(maskArea), scaledPixels, Image::FILTER_BILINEAR);
+		srcPixels = scaledPixels;
+	}
+
 	TexturePtr maskTexture = TextureManager::getSingleton().createManual(
 		naviName + "MaskTexture", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-		TEX_TYPE_2D, texWidth, texHeight, 0, PF_BYTE_A, TU_STATIC_WRITE_ONLY);
+		TEX_TYPE_2D, maskTexWidth, maskTexHeight, 0, PF_BYTE_A, TU_STATIC_WRITE_ONLY);
 
 	HardwarePixelBufferSharedPtr pixelBuffer = maskTexture->getBuffer();
 	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
@@ -414,21 +1318,21 @@ void Navi::setMask(std::string maskFileName, std::string groupName)
 	size_t maskTexDepth = Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
 	maskPitch = pixelBox.rowPitch;
 
-	maskCache = new unsigned char[maskPitch*texHeight];
+	maskCache = new unsigned char[maskPitch*maskTexHeight];
 
 	uint8* buffer = static_cast<uint8*>(pixelBox.data);
 
-	memset(buffer, 0, maskPitch * texHeight);
+	memset(buffer, 0, maskPitch * maskTexHeight);
 
 	size_t minRowSpan = std::min(maskPitch, srcPixels.rowPitch);
-	size_t minHeight = std::min(texHeight, (unsigned short)srcPixels.getHeight());
+	size_t minHeight = std::min(maskTexHeight, (unsigned short)srcPixels.getHeight());
 
 	if(maskTexDepth == 1)
 	{
 		for(unsigned int row = 0; row < minHeight; row++)
 			memcpy(buffer + row * maskPitch, (unsigned char*)srcPixels.data + row * srcPixels.rowPitch, minRowSpan);
 
-		memcpy(maskCache, buffer, maskPitch*texHeight);
+		memcpy(maskCache, buffer, maskPitch*maskTexHeight);
 	}
 	else if(maskTexDepth == 4)
 	{
@@ -456,7 +1360,32 @@ void Navi::setMask(std::string maskFileName, std::string groupName)
 	if(conversionBuf)
 		delete[] conversionBuf;
 
-	maskTexUnit->setTextureName(naviName + "MaskTexture");
+	if(scaledBuf)
+		delete[] scaledBuf;
+
+	// A mask that is fully opaque over the visible area lets this Navi occlude the Navis beneath it
+	maskOpaque = true;
+	for(unsigned int row = 0; row < renderHeight && maskOpaque; row++)
+		for(unsigned int col = 0; col < renderWidth; col++)
+			if(maskCache[row * maskPitch + col] != 255)
+			{
+				maskOpaque = false;
+				break;
+			}
+
+	if(sharingMaterial)
+	{
+		usingMask = true;
+		bindSharedMaterial();
+	}
+	else
+	{
+		maskTexUnit->setTextureName(naviName + "MaskTexture");
+		NaviManager::Get().frameStats.materialStateChanges++;
+	}
+	if(texturePacked && !usingShaders)
+		updateTextureRects();
+	NaviManager::Get().compositeDirty = true;
 	usingMask = true;
 }
 
@@ -465,6 +1394,172 @@ void Navi::setMaxUPS(unsigned int maxUPS)
 	maxUpdatePS = maxUPS;
 }
 
+void Navi::setLODAnchor(Ogre::SceneNode* anchor)
+{
+	lodAnchor = anchor;
+}
+
+void Navi::setLODDistances(Ogre::Real fullRateDistance, Ogre::Real minRateDistance, unsigned int minUPS)
+{
+	lodFullRateDistance = fullRateDistance;
+	lodMinRateDistance = std::max(minRateDistance, fullRateDistance);
+	lodMinUpdatePS = std::max(minUPS, 1u);
+}
+
+void Navi::setLODCoverage(Ogre::Real fullRateCoverage, unsigned int minUPS)
+{
+	lodFullRateCoverage = std::min(fullRateCoverage, (Real)1);
+	lodMinUpdatePS = std::max(minUPS, 1u);
+}
+
+void Navi::setProjectedCoverage(Ogre::Real coverage)
+{
+	projectedCoverage = std::min(coverage, (Real)1);
+}
+
+Ogre::Real Navi::getProjectedCoverage() const
+{
+	if(projectedCoverage >= 0)
+		return projectedCoverage;
+
+	Camera* lodCamera = NaviManager::Get().lodCamera;
+
+	if(!lodAnchor || !lodCamera)
+		return -1;
+
+	const AxisAlignedBox& bounds = lodAnchor->_getWorldAABB();
+
+	if(bounds.isNull())
+		return -1;
+
+	if(bounds.isInfinite())
+		return 1;
+
+	if(!lodCamera->isVisible(bounds))
+		return 0;
+
+	Real distance = lodCamera->getDerivedPosition().distance(bounds.getCenter());
+	Real radius = bounds.getSize().length() * 0.5f;
+
+	if(distance <= radius)
+		return 1;
+
+	// Project the bounding sphere: its radius relative to the half-height of the viewport at that distance
+	Real projectedRadius = radius / (distance * Math::Tan(lodCamera->getFOVy() * 0.5f));
+
+	return std::min(Math::PI * projectedRadius * projectedRadius / (4 * lodCamera->getAspectRatio()), (Real)1);
+}
+
+unsigned int Navi::getUpdateRate() const
+{
+	Camera* lodCamera = NaviManager::Get().lodCamera;
+	Real detail = 1;
+
+	if(lodAnchor && lodCamera && lodMinRateDistance > 0)
+	{
+		Real distance = lodCamera->getDerivedPosition().distance(lodAnchor->_getDerivedPosition());
+
+		if(distance > lodFullRateDistance)
+			detail = lodMinRateDistance > lodFullRateDistance ? 
+				1 - std::min((distance - lodFullRateDistance) / (lodMinRateDistance - lodFullRateDistance), (Real)1) : 0;
+	}
+
+	if(lodFullRateCoverage > 0)
+	{
+		Real coverage = getProjectedCoverage();
+
+		if(coverage >= 0)
+			detail = std::min(detail, coverage / lodFullRateCoverage);
+	}
+
+	if(detail >= 1)
+		return maxUpdatePS;
+
+	Real fullRate = maxUpdatePS ? (Real)maxUpdatePS : 60;
+
+	return std::max((unsigned int)(lodMinUpdatePS + (fullRate - lodMinUpdatePS) * detail), lodMinUpdatePS);
+}
+
+void Navi::setResolutionScale(float resolutionScale)
+{
+	limit<float>(resolutionScale, 0.1f, 1);
+
+	unsigned short width = std::max(1, (int)(naviWidth * resolutionScale + 0.5f));
+	unsigned short height = std::max(1, (int)(naviHeight * resolutionScale + 0.5f));
+
+	this->resolutionScale = resolutionScale;
+
+	if(width == renderWidth && height == renderHeight)
+		return;
+
+	renderWidth = width;
+	renderHeight = height;
+
+	// Awesomium can't resize a WebView, re-create it (and our texture) at the new resolution
+	webView->destroy();
+	webView = 0;
+
+	destroyTexture();
+	createTexture();
+	if(sharingMaterial)
+	{
+		bindSharedMaterial();
+	}
+	else
+	{
+		baseTexUnit->setTextureName(textureName);
+		NaviManager::Get().frameStats.materialStateChanges++;
+	}
+
+	updateTextureRects();
+	createShadowSurface();
+
+	createWebView();
+
+	for(std::map<std::string, NaviDelegate>::iterator i = delegateMap.begin(); i != delegateMap.end(); ++i)
+		webView->setCallback(i->first);
+
+	for(std::map<std::string, Awesomium::JSValue>::iterator i = propertyMap.begin(); i != propertyMap.end(); ++i)
+		webView->setProperty(i->first, i->second);
+
+	if(lastLoadType == LoadURL)
+		webView->loadURL(lastLoad);
+	else if(lastLoadType == LoadFile)
+		loadFile(lastLoad);
+	else if(lastLoadType == LoadHTML)
+		webView->loadHTML(lastLoad);
+
+	if(usingMask)
+		setMask(maskName, maskGroup);
+
+	NaviManager::Get().compositeDirty = true;
+}
+
+void Navi::applyZoom()
+{
+	// Awesomium has no zoom of its own: let the page lay out at our full size and render it at the reduced one
+	char zoom[NumberBufferSize];
+	zoom[formatNumber((float)renderWidth / naviWidth, zoom)] = 0;
+
+	webView->executeJavascript(std::string("document.documentElement.style.zoom = '") + zoom + "';");
+	zoomPending = false;
+}
+
+float Navi::getResolutionScale()
+{
+	return resolutionScale;
+}
+
+int Navi::toRenderX(int x) const
+{
+	return renderWidth == naviWidth ? x : x * renderWidth / naviWidth;
+}
+
+int Navi::toRenderY(int y) const
+{
+	return renderHeight == naviHeight ? y : y * renderHeight / naviHeight;
+}
+
 void Navi::setMovable(bool isMovable)
 {
 	if(!isMaterial)
@@ -474,8 +1569,35 @@ void Navi::setMovable(bool isMovable)
 void Navi::setOpacity(float opacity)
 {
 	limit<float>(opacity, 0, 1);
+
+	NaviManager::Get().stopTween(this, NaviManager::TweenOpacity);
 	
 	this->opacity = opacity;
+	applyOpacity();
+}
+
+void Navi::animateOpacity(float opacity, unsigned short durationMS, EasingCurve easing)
+{
+	limit<float>(opacity, 0, 1);
+
+	NaviManager::Get().startTween(this, NaviManager::TweenOpacity, this->opacity, 0, opacity, 0, durationMS, easing);
+}
+
+void Navi::animatePosition(int left, int top, unsigned short durationMS, EasingCurve easing)
+{
+	if(isMaterial)
+		return;
+
+	NaviManager::Get().startTween(this, NaviManager::TweenPosition, panel->getLeft(), panel->getTop(), 
+		(float)left, (float)top, durationMS, easing);
+}
+
+void Navi::animateScale(float scale, unsigned short durationMS, EasingCurve easing)
+{
+	if(isMaterial || scale <= 0)
+		return;
+
+	NaviManager::Get().startTween(this, NaviManager::TweenScale, this->scale, 0, scale, 0, durationMS, easing);
 }
 
 void Navi::setPosition(const NaviPosition &naviPosition)
@@ -491,6 +1613,8 @@ void Navi::resetPosition()
 {
 	if(isMaterial || !overlay || !panel) return;
 
+	NaviManager::Get().stopTween(this, NaviManager::TweenPosition);
+
 	if(position.usingRelative)
 	{
 		int left = 0 + position.data.rel.x;
@@ -538,41 +1662,49 @@ void Navi::resetPosition()
 	else
 		panel->setPosition(position.data.abs.left, position.data.abs.top);
 
-	return;
+	NaviManager::Get().compositeDirty = true;
 }
 
 void Navi::hide(bool fade, unsigned short fadeDurationMS)
 {
-	if(fadingIn || fadingOut)
-		fadingInStart = fadingInEnd = fadingOutStart = fadingOutEnd = fadingIn = fadingOut = 0;
-
-	if(fade)
+	if(fade && isVisible)
 	{
-		fadingOutStart = timer.getMilliseconds();
-		fadingOutEnd = timer.getMilliseconds() + fadeDurationMS + 1;
-		fadingOut = true;
+		NaviManager::Get().startTween(this, NaviManager::TweenFade, fadeOpacity, 0, 0, 0, fadeDurationMS + 1, EaseLinear);
 	}
 	else
 	{
-		if(!isMaterial) overlay->hide();
+		NaviManager::Get().stopTween(this, NaviManager::TweenFade);
+		fadeOpacity = 1;
+		applyOpacity();
+
 		isVisible = false;
+		updateOverlayVisibility();
+		NaviManager::Get().compositeDirty = true;
 	}
 }
 
 void Navi::show(bool fade, unsigned short fadeDurationMS)
 {
-	if(fadingIn || fadingOut)
-		fadingInStart = fadingInEnd = fadingOutStart = fadingOutEnd = fadingIn = fadingOut = 0;
-
 	if(fade)
 	{
-		fadingInStart = timer.getMilliseconds();
-		fadingInEnd = timer.getMilliseconds() + fadeDurationMS + 1;
-		fadingIn = true;
+		if(!isVisible)
+		{
+			fadeOpacity = 0;
+			applyOpacity();
+		}
+
+		NaviManager::Get().startTween(this, NaviManager::TweenFade, fadeOpacity, 0, 1, 0, fadeDurationMS + 1, EaseLinear);
+	}
+	else
+	{
+		NaviManager::Get().stopTween(this, NaviManager::TweenFade);
+		fadeOpacity = 1;
+		applyOpacity();
 	}
 
 	isVisible = true;
-	if(!isMaterial) overlay->show();
+	updateOverlayVisibility();
+	NaviManager::Get().compositeDirty = true;
 }
 
 void Navi::focus()
@@ -585,8 +1717,12 @@ void Navi::focus()
 
 void Navi::moveNavi(int deltaX, int deltaY)
 {
-	if(!isMaterial)
-		panel->setPosition(panel->getLeft()+deltaX, panel->getTop()+deltaY);
+	if(isMaterial)
+		return;
+
+	NaviManager::Get().stopTween(this, NaviManager::TweenPosition);
+	panel->setPosition(panel->getLeft()+deltaX, panel->getTop()+deltaY);
+	NaviManager::Get().compositeDirty = true;
 }
 
 void Navi::getExtents(unsigned short &width, unsigned short &height)
@@ -599,7 +1735,7 @@ int Navi::getRelativeX(int absX)
 {
 	if(isMaterial) return 0;
 
-	int relX = absX - panel->getLeft();
+	int relX = (int)((absX - panel->getLeft()) / scale);
 	limit<int>(relX, 0, naviWidth-1);
 
 	return relX;
@@ -609,7 +1745,7 @@ int Navi::getRelativeY(int absY)
 {
 	if(isMaterial) return 0;
 
-	int relY = absY - panel->getTop();
+	int relY = (int)((absY - panel->getTop()) / scale);
 	limit<int>(relY, 0, naviHeight - 1);
 	
 	return relY;
@@ -633,9 +1769,14 @@ std::string Navi::getName()
 	return naviName;
 }
 
+const std::string& Navi::getTitle() const
+{
+	return pageTitle;
+}
+
 std::string Navi::getMaterialName()
 {
-	return naviName + "Material";
+	return materialName;
 }
 
 bool Navi::getVisibility()
@@ -648,16 +1789,181 @@ void Navi::getDerivedUV(Ogre::Real& u1, Ogre::Real& v1, Ogre::Real& u2, Ogre::Re
 	u1 = v1 = 0;
 	u2 = v2 = 1;
 
-	if(compensateNPOT)
+	if(compensateNPOT && !usingShaders)
+	{
+		if(texturePacked)
+		{
+			u1 = (Ogre::Real)atlasLeft/texWidth;
+			v1 = (Ogre::Real)atlasTop/(Ogre::Real)texHeight;
+		}
+
+		u2 = u1 + (Ogre::Real)renderWidth/texWidth;
+		v2 = v1 + (Ogre::Real)renderHeight/(Ogre::Real)texHeight;
+	}
+}
+
+void Navi::getTextureMemoryUsage(size_t& allocated, size_t& required)
+{
+	size_t levels = texMipmaps;
+	if(levels == MIP_UNLIMITED)
+		for(levels = 0; (texWidth >> levels) > 1 || (texHeight >> levels) > 1; levels++);
+
+	allocated = required = 0;
+
+	for(size_t level = 0; level <= levels; level++)
+	{
+		if(texturePacked)
+			allocated += atlasWidth * atlasHeight * texDepth;
+		else if(!textureEvicted)
+			allocated += std::max(texWidth >> level, 1) * std::max(texHeight >> level, 1) * texDepth;
+
+		required += std::max(renderWidth >> level, 1) * std::max(renderHeight >> level, 1) * texDepth;
+	}
+
+	if(usingMask)
+	{
+		allocated += maskTexWidth * maskTexHeight;
+		required += renderWidth * renderHeight;
+	}
+}
+
+size_t Navi::getSystemMemoryUsage()
+{
+	size_t usage = 0;
+
+	if(mipChain)
+		usage += mipOffsets.back() + 4;
+
+	if(maskCache)
+		usage += maskPitch * maskTexHeight;
+
+	if(shadowSurface)
+		usage += shadowPitch * renderHeight + 4095;
+
+	for(std::map<std::string, NaviImage>::const_iterator i = imageMap.begin(); i != imageMap.end(); ++i)
+		usage += i->second.pixels.capacity() + i->second.scaled.capacity();
+
+	return usage;
+}
+
+void Navi::setShadowSurface(bool enabled)
+{
+	if(enabled == useShadowSurface)
+		return;
+
+	useShadowSurface = enabled;
+
+	if(!textureEvicted)
+		createShadowSurface();
+}
+
+const unsigned char* Navi::getShadowSurface(size_t& pitch)
+{
+	if(mipChain)
+	{
+		pitch = texWidth * 4;
+		return mipChain;
+	}
+
+	pitch = shadowPitch;
+	return shadowSurface;
+}
+
+void Navi::captureToImage(Ogre::Image& image, unsigned short width, unsigned short height)
+{
+	if(!width)
+		width = naviWidth;
+	if(!height)
+		height = naviHeight;
+
+	size_t srcPitch;
+	const unsigned char* src = getShadowSurface(srcPitch);
+	unsigned char* renderBuffer = 0;
+
+	if(!src)
+	{
+		// Rendering clears the dirty state of the WebView, make sure our texture still catches up
+		if(webView->isDirty())
+			needsRefresh = true;
+
+		srcPitch = renderWidth * 4;
+		renderBuffer = new unsigned char[srcPitch * renderHeight];
+		webView->render(renderBuffer, (int)srcPitch, 4);
+		drawImages(renderBuffer, srcPitch, 4, Box(0, 0, renderWidth, renderHeight));
+		src = renderBuffer;
+	}
+
+	uint8* dest = OGRE_ALLOC_T(uint8, width * height * 4, MEMCATEGORY_GENERAL);
+
+	if(width == renderWidth && height == renderHeight)
 	{
-		u2 = (Ogre::Real)naviWidth/texWidth;
-		v2 = (Ogre::Real)naviHeight/(Ogre::Real)texHeight;
+		for(unsigned int row = 0; row < height; row++)
+			memcpy(dest + row * width * 4, src + row * srcPitch, width * 4);
 	}
+	else
+		scaleBGRA(src, renderWidth, renderHeight, srcPitch, dest, width, height);
+
+	if(renderBuffer)
+		delete[] renderBuffer;
+
+	for(size_t i = 3; i < (size_t)width * height * 4; i += 4)
+		dest[i] = 255;
+
+	image.loadDynamicImage(dest, width, height, 1, PF_BYTE_BGRA, true);
+}
+
+void Navi::setImage(const std::string& name, const unsigned char* pixels, unsigned short width, unsigned short height, size_t rowPitch)
+{
+	// Navi.js reports image regions as "name,left,top,width,height;..."
+	if(name.find_first_of(",;") != std::string::npos)
+		OGRE_EXCEPT(Ogre::Exception::ERR_RT_ASSERTION_FAILED, 
+			"An attempt was made to set an image named '" + name + "' but image names may not contain ',' or ';'.", 
+			"Navi::setImage");
+
+	if(!width || !height)
+	{
+		removeImage(name);
+		return;
+	}
+
+	if(!rowPitch)
+		rowPitch = width * 4;
+
+	// Replacing the pixels of an image of the same size reuses its buffers
+	NaviImage& image = imageMap[name];
+	image.pixels.resize((size_t)width * height * 4);
+
+	for(unsigned short row = 0; row < height; row++)
+		memcpy(&image.pixels[row * width * 4], pixels + row * rowPitch, width * 4);
+
+	image.width = width;
+	image.height = height;
+
+	scaleImage(image);
+	invalidateImage(image);
+}
+
+void Navi::removeImage(const std::string& name)
+{
+	std::map<std::string, NaviImage>::iterator i = imageMap.find(name);
+
+	if(i == imageMap.end())
+		return;
+
+	// The page has to be rendered again where the image was drawn
+	Box rect;
+	if(getImageRect(i->second, rect))
+		needsRefresh = true;
+
+	// Keep the region reported by the page in case the image is set again
+	std::vector<unsigned char>().swap(i->second.pixels);
+	std::vector<unsigned char>().swap(i->second.scaled);
+	i->second.width = i->second.height = 0;
 }
 
 void Navi::injectMouseMove(int xPos, int yPos)
 {
-	webView->injectMouseMove(xPos, yPos);
+	webView->injectMouseMove(toRenderX(xPos), toRenderY(yPos));
 }
 
 void Navi::injectMouseWheel(int relScroll)
@@ -677,18 +1983,38 @@ void Navi::injectMouseUp(int xPos, int yPos)
 
 void Navi::onBeginNavigation(const std::string& url)
 {
+	// Remember where the user navigated to so that we can come back here if the WebView is re-created
+	if(!url.empty() && url != "about:blank")
+	{
+		lastLoadType = LoadURL;
+		lastLoad = url;
+	}
 }
 
 void Navi::onBeginLoading()
 {
+	zoomPending = renderWidth != naviWidth || renderHeight != naviHeight;
+
+	// The new page reports its own image regions once it is ready
+	updateImageRegions("");
 }
 
 void Navi::onFinishLoading()
 {
+	if(zoomPending)
+		applyZoom();
 }
 
 void Navi::onCallback(const std::string& name, const Awesomium::JSArguments& args)
 {
+	if(name == "NaviImageRegions")
+	{
+		if(args.size() && args[0].isString())
+			updateImageRegions(args[0].toString());
+
+		return;
+	}
+
 	std::map<std::string, NaviDelegate>::iterator i = delegateMap.find(name);
 
 	if(i != delegateMap.end())
@@ -697,6 +2023,7 @@ void Navi::onCallback(const std::string& name, const Awesomium::JSArguments& arg
 
 void Navi::onReceiveTitle(const std::wstring& title)
 {
+	NaviUtilities::toMultibyte(title, pageTitle);
 }
 
 void Navi::onChangeCursor(Awesomium::WebCursor cursor)
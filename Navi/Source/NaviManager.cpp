@@ -23,6 +23,8 @@
 #include "NaviManager.h"
 #include "Navi.h"
 #include <algorithm>
+#include <ctype.h>
+#include <OgreHighLevelGpuProgramManager.h>
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 #include <direct.h>
 #include <stdlib.h>
@@ -33,6 +35,113 @@ using namespace NaviLibrary::NaviUtilities;
 
 template<> NaviManager* Singleton<NaviManager>::instance = 0;
 
+namespace
+{
+	const char* naviProgramHLSL =
+		"sampler2D baseMap : register(s0);\n"
+		"sampler2D maskMap : register(s1);\n"
+		"uniform float4 naviParams;\n"
+		"uniform float4 baseRect;\n"
+		"uniform float4 maskRect;\n"
+		"float4 main(float2 uv : TEXCOORD0) : COLOR\n"
+		"{\n"
+		"	float3 colour = tex2D(baseMap, baseRect.xy + uv * baseRect.zw).rgb;\n"
+		"	float alpha = tex2D(maskMap, maskRect.xy + uv * maskRect.zw).a;\n"
+		"	return float4(colour, alpha * naviParams.x);\n"
+		"}\n";
+
+	const char* naviProgramGLSL =
+		"uniform sampler2D baseMap;\n"
+		"uniform sampler2D maskMap;\n"
+		"uniform vec4 naviParams;\n"
+		"uniform vec4 baseRect;\n"
+		"uniform vec4 maskRect;\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 uv = gl_TexCoord[0].xy;\n"
+		"	vec3 colour = texture2D(baseMap, baseRect.xy + uv * baseRect.zw).rgb;\n"
+		"	float alpha = texture2D(maskMap, maskRect.xy + uv * maskRect.zw).a;\n"
+		"	gl_FragColor = vec4(colour, alpha * naviParams.x);\n"
+		"}\n";
+
+	struct OcclusionRect
+	{
+		int left, top, right, bottom;
+
+		OcclusionRect(int left, int top, int right, int bottom) : left(left), top(top), right(right), bottom(bottom) {}
+	};
+
+	OcclusionRect getPanelRect(Ogre::PanelOverlayElement* panel)
+	{
+		int left = (int)panel->getLeft();
+		int top = (int)panel->getTop();
+		return OcclusionRect(left, top, left + (int)panel->getWidth(), top + (int)panel->getHeight());
+	}
+
+	/**
+	* Removes 'occluder' from every rectangle in 'region', splitting partially covered rectangles into
+	* at most four uncovered strips.
+	*/
+	void subtractRect(std::vector<OcclusionRect>& region, const OcclusionRect& occluder)
+	{
+		std::vector<OcclusionRect> result;
+
+		for(std::vector<OcclusionRect>::const_iterator i = region.begin(); i != region.end(); ++i)
+		{
+			const OcclusionRect& r = *i;
+
+			if(occluder.left >= r.right || occluder.right <= r.left || occluder.top >= r.bottom || occluder.bottom <= r.top)
+			{
+				result.push_back(r);
+				continue;
+			}
+
+			int top = std::max(r.top, occluder.top);
+			int bottom = std::min(r.bottom, occluder.bottom);
+
+			if(r.top < occluder.top)
+				result.push_back(OcclusionRect(r.left, r.top, r.right, occluder.top));
+			if(r.bottom > occluder.bottom)
+				result.push_back(OcclusionRect(r.left, occluder.bottom, r.right, r.bottom));
+			if(r.left < occluder.left)
+				result.push_back(OcclusionRect(r.left, top, occluder.left, bottom));
+			if(r.right > occluder.right)
+				result.push_back(OcclusionRect(occluder.right, top, r.right, bottom));
+		}
+
+		region.swap(result);
+	}
+
+	/**
+	* Turns a file system path into the path of a file URL: backslashes become slashes, characters that have
+	* a meaning in URLs (or would end an unquoted CSS url()) are percent-encoded.
+	*/
+	std::string encodePath(const std::string& path)
+	{
+		static const char hexDigits[] = "0123456789ABCDEF";
+		std::string encoded;
+		encoded.reserve(path.size());
+
+		for(size_t i = 0; i < path.size(); i++)
+		{
+			char c = path[i];
+
+			if(c == '\\')
+				encoded += '/';
+			else if(c && strchr(" \"#%'()?", c))
+			{
+				encoded += '%';
+				encoded += hexDigits[(unsigned char)c >> 4];
+				encoded += hexDigits[c & 0xF];
+			}
+			else
+				encoded += c;
+		}
+
+		return encoded;
+	}
+}
+
 NaviPosition::NaviPosition()
 {
 	usingRelative = false;
@@ -56,10 +165,15 @@ NaviPosition::NaviPosition(short absoluteLeft, short absoluteTop)
 }
 
 NaviManager::NaviManager(Ogre::RenderWindow* renderWindow, const std::string &baseDirectory)
-	: webCore(0), focusedNavi(0), mouseXPos(0), mouseYPos(0), mouseButtonRDown(false), zOrderCounter(5), renderWindow(renderWindow)
+	: webCore(0), focusedNavi(0), mouseXPos(0), mouseYPos(0), mouseButtonRDown(false), zOrderCounter(5), renderWindow(renderWindow),
+	useShaders(false), shadersSupported(true), sharedMaterialCounter(0), compositing(false), compositeDirty(false), compositeSceneMgr(0), 
+	compositeCamera(0), compositeOverlay(0), compositePanel(0), compositeWidth(0), compositeHeight(0), lodCamera(0),
+	texturePacking(false), texturePageSize(1024), texturePageCounter(0), textureMemoryBudget(0), systemMemoryBudget(0),
+	frameCounter(0), restoreBudget(1048576)
 {
 	webCore = new Awesomium::WebCore();
 	webCore->setBaseDirectory(NaviUtilities::getCurrentWorkingDirectory() + baseDirectory + "\\");
+	baseDirectoryURL = "file:///" + encodePath(NaviUtilities::getCurrentWorkingDirectory() + baseDirectory + "\\");
 	keyboardHook = new Impl::KeyboardHook(this);
 }
 
@@ -71,11 +185,23 @@ NaviManager::~NaviManager()
 	{
 		Navi* toDelete = iter->second;
 		iter = activeNavis.erase(iter);
+		if(compositing) detachFromComposite(toDelete);
 		delete toDelete;
 	}
 
+	if(compositing)
+		destroyCompositeLayer();
+
 	if(webCore)
 		delete webCore;
+
+	if(shaderProgramName.size())
+	{
+		Ogre::TextureManager::getSingleton().remove("NaviWhiteMaskTexture");
+		Ogre::HighLevelGpuProgramManager::getSingleton().remove(shaderProgramName);
+	}
+
+	NaviUtilities::flushLog();
 }
 
 NaviManager& NaviManager::Get()
@@ -97,6 +223,12 @@ void NaviManager::Update()
 {
 	webCore->update();
 
+	updateTweens();
+
+	updateOcclusion();
+
+	scheduleRestores();
+
 	std::map<std::string,Navi*>::iterator end;
 	end = activeNavis.end();
 	iter = activeNavis.begin();
@@ -108,6 +240,8 @@ void NaviManager::Update()
 			Navi* naviToDelete = iter->second;
 			iter = activeNavis.erase(iter);
 			if(focusedNavi == naviToDelete) focusedNavi = 0;
+			stopAllTweens(naviToDelete);
+			if(compositing) detachFromComposite(naviToDelete);
 			delete naviToDelete;
 		}
 		else
@@ -116,6 +250,17 @@ void NaviManager::Update()
 			iter++;
 		}
 	}
+
+	enforceMemoryBudget();
+
+	updateCompositeLayer();
+
+	NaviUtilities::flushLog();
+
+	frameCounter++;
+
+	lastFrameStats = frameStats;
+	frameStats = NaviFrameStats();
 }
 
 Navi* NaviManager::createNavi(const std::string &naviName, const NaviPosition &naviPosition,
@@ -129,18 +274,23 @@ Navi* NaviManager::createNavi(const std::string &naviName, const NaviPosition &n
 			"An attempt was made to create a Navi named '" + naviName + "' when a Navi by the same name already exists!", 
 			"NaviManager::createNavi");
 
-	return activeNavis[naviName] = new Navi(renderWindow, naviName, naviPosition, width, height, zOrder);
+	Navi* navi = activeNavis[naviName] = new Navi(renderWindow, naviName, naviPosition, width, height, zOrder);
+
+	if(compositing)
+		attachToComposite(navi);
+
+	return navi;
 }
 
 Navi* NaviManager::createNaviMaterial(const std::string &naviName, unsigned short width, unsigned short height,
-									  Ogre::FilterOptions texFiltering)
+									  Ogre::FilterOptions texFiltering, bool mipmaps)
 {
 	if(activeNavis.find(naviName) != activeNavis.end())
 		OGRE_EXCEPT(Ogre::Exception::ERR_RT_ASSERTION_FAILED, 
 			"An attempt was made to create a Navi named '" + naviName + "' when a Navi by the same name already exists!", 
 			"NaviManager::createNaviMaterial");
 
-	return activeNavis[naviName] = new Navi(renderWindow, naviName, width, height, texFiltering);
+	return activeNavis[naviName] = new Navi(renderWindow, naviName, width, height, texFiltering, mipmaps);
 }
 
 Navi* NaviManager::getNavi(const std::string &naviName)
@@ -268,6 +418,449 @@ bool NaviManager::injectMouseUp(int buttonID)
 	return false;
 }
 
+void NaviManager::setUseShaders(bool useShaders)
+{
+	this->useShaders = useShaders;
+}
+
+void NaviManager::setCompositing(bool enabled)
+{
+	if(compositing == enabled)
+		return;
+
+	if(enabled)
+		createCompositeLayer();
+
+	compositing = enabled;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
+		if(iter->second->isMaterial)
+			continue;
+
+		if(enabled)
+			attachToComposite(iter->second);
+		else
+			detachFromComposite(iter->second);
+
+		iter->second->updateOverlayVisibility();
+	}
+
+	if(!enabled)
+		destroyCompositeLayer();
+}
+
+void NaviManager::setLODCamera(Ogre::Camera* camera)
+{
+	lodCamera = camera;
+}
+
+void NaviManager::setTexturePacking(bool enabled, unsigned short pageSize)
+{
+	texturePacking = enabled;
+	texturePageSize = Ogre::Bitwise::firstPO2From(pageSize);
+}
+
+void NaviManager::getTextureMemoryUsage(size_t& allocated, size_t& required)
+{
+	allocated = required = 0;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
+		size_t naviAllocated, naviRequired;
+		iter->second->getTextureMemoryUsage(naviAllocated, naviRequired);
+
+		// Texture pages are accounted for as a whole below, only count the Alpha Mask of packed Navis
+		if(iter->second->texturePacked)
+			naviAllocated = iter->second->usingMask ? iter->second->maskTexWidth * iter->second->maskTexHeight : 0;
+
+		allocated += naviAllocated;
+		required += naviRequired;
+	}
+
+	for(std::vector<TexturePage>::iterator i = texturePages.begin(); i != texturePages.end(); ++i)
+	{
+		Ogre::TexturePtr texture = Ogre::TextureManager::getSingleton().getByName(i->textureName);
+		allocated += i->size * i->size * Ogre::PixelUtil::getNumElemBytes(texture->getFormat());
+	}
+}
+
+size_t NaviManager::getSystemMemoryUsage()
+{
+	size_t usage = 0;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+		usage += iter->second->getSystemMemoryUsage();
+
+	return usage;
+}
+
+void NaviManager::setMemoryBudget(size_t textureBytes, size_t systemBytes)
+{
+	textureMemoryBudget = textureBytes;
+	systemMemoryBudget = systemBytes;
+}
+
+void NaviManager::setRestoreBudget(unsigned int pixelsPerFrame)
+{
+	restoreBudget = pixelsPerFrame;
+}
+
+namespace
+{
+	/**
+	* Resolves the "." and ".." segments of a relative path, with forward slashes. Segments that would leave
+	* the base directory are kept (such paths just aren't in the cache).
+	*/
+	std::string normalizePath(const std::string& path)
+	{
+		std::string slashed = path;
+		std::replace(slashed.begin(), slashed.end(), '\\', '/');
+
+		std::vector<std::string> segments;
+		Splitter splitter(slashed, "/");
+		StringRef segment;
+
+		while(splitter.next(segment))
+		{
+			if(segment == "..")
+			{
+				if(!segments.empty() && segments.back() != "..")
+					segments.pop_back();
+				else
+					segments.push_back("..");
+			}
+			else if(segment != ".")
+				segments.push_back(segment.str());
+		}
+
+		std::string normalized;
+		for(size_t i = 0; i < segments.size(); i++)
+		{
+			if(i)
+				normalized += '/';
+			normalized += segments[i];
+		}
+
+		return normalized;
+	}
+
+	/**
+	* Normalizes a resource name into a cache key: a normalized path (see normalizePath), lower-case because the
+	* base directory is on a case-insensitive file system.
+	*/
+	std::string toResourceKey(const std::string& name)
+	{
+		return lowerString(normalizePath(name));
+	}
+
+	/**
+	* Returns the directory part of a normalized path, including its trailing slash.
+	*/
+	std::string getDirectory(const std::string& path)
+	{
+		return path.substr(0, path.rfind('/') + 1);
+	}
+
+	bool isRelativeURL(const std::string& url)
+	{
+		return !url.empty() && url[0] != '/' && url[0] != '#' && url.find(':') == std::string::npos;
+	}
+
+	/**
+	* Escapes every occurrence (in any case) of a closing tag such as "</script" within the body of an element
+	* that is inlined into a page, where it would end the element early. "<\/script" means the same in both
+	* scripts and stylesheets.
+	*/
+	void escapeClosingTag(std::string& body, const std::string& closingTag)
+	{
+		const std::string lowerBody = lowerString(body);
+		size_t inserted = 0;
+
+		for(size_t pos = lowerBody.find(closingTag); pos != std::string::npos; pos = lowerBody.find(closingTag, pos + 1))
+			body.insert(pos + 1 + inserted++, 1, '\\');
+	}
+
+	/**
+	* Copies a stylesheet that is about to be inlined, making its relative url(...) references absolute ('directory'
+	* is that of the stylesheet, relative to 'baseURL'). Once inlined, they would otherwise be resolved relative to
+	* the page instead of the stylesheet.
+	*/
+	void rebaseStylesheet(const std::string& css, const std::string& baseURL, const std::string& directory, std::string& result)
+	{
+		const std::string lowerCSS = lowerString(css);
+		size_t copied = 0;
+
+		result.clear();
+		result.reserve(css.size());
+
+		for(size_t pos = lowerCSS.find("url("); pos != std::string::npos; pos = lowerCSS.find("url(", pos + 1))
+		{
+			size_t begin = pos + 4;
+			while(begin < css.size() && isspace((unsigned char)css[begin]))
+				begin++;
+
+			char quote = begin < css.size() && (css[begin] == '"' || css[begin] == '\'') ? css[begin] : 0;
+			if(quote)
+				begin++;
+
+			size_t end = css.find(quote ? quote : ')', begin);
+			if(end == std::string::npos)
+				break;
+
+			if(!quote)
+				while(end > begin && isspace((unsigned char)css[end - 1]))
+					end--;
+
+			std::string url = css.substr(begin, end - begin);
+			if(!isRelativeURL(url))
+				continue;
+
+			result.append(css, copied, begin - copied);
+			result += baseURL + normalizePath(directory + url);
+			copied = end;
+		}
+
+		result.append(css, copied, std::string::npos);
+	}
+
+	/**
+	* Makes a page that is loaded from memory resolve its remaining relative URLs (images, uncached scripts,
+	* links) against the directory it came from, unless it already has a <base> of its own.
+	*/
+	void insertBaseURL(std::string& html, const std::string& baseURL)
+	{
+		const std::string lowerHTML = lowerString(html);
+
+		if(lowerHTML.find("<base") != std::string::npos)
+			return;
+
+		size_t insertAt = 0;
+		const char* parents[] = { "<head", "<html" };
+
+		for(int i = 0; i < 2 && !insertAt; i++)
+		{
+			for(size_t pos = lowerHTML.find(parents[i]); pos != std::string::npos; pos = lowerHTML.find(parents[i], pos + 1))
+			{
+				char next = lowerHTML[pos + 5];
+
+				if(next == '>' || isspace((unsigned char)next))
+				{
+					size_t tagEnd = lowerHTML.find('>', pos);
+					insertAt = tagEnd == std::string::npos ? 0 : tagEnd + 1;
+					break;
+				}
+			}
+		}
+
+		html.insert(insertAt, "<base href=\"" + baseURL + "\">");
+	}
+
+	/**
+	* Finds an attribute within the tag [tagBegin, tagEnd) of a lower-cased copy of a page. On success, 'attrBegin'
+	* and 'attrEnd' span the whole attribute (including its name) and 'valueBegin' and 'valueEnd' its value.
+	*/
+	bool findAttribute(const std::string& lowerHTML, size_t tagBegin, size_t tagEnd, const std::string& name,
+		size_t& attrBegin, size_t& attrEnd, size_t& valueBegin, size_t& valueEnd)
+	{
+		for(size_t pos = lowerHTML.find(name, tagBegin); pos < tagEnd; pos = lowerHTML.find(name, pos + 1))
+		{
+			if(!isspace((unsigned char)lowerHTML[pos - 1]))
+				continue;
+
+			size_t cursor = pos + name.length();
+			while(cursor < tagEnd && isspace((unsigned char)lowerHTML[cursor]))
+				cursor++;
+
+			if(cursor == tagEnd || lowerHTML[cursor] != '=')
+				continue;
+
+			cursor++;
+			while(cursor < tagEnd && isspace((unsigned char)lowerHTML[cursor]))
+				cursor++;
+
+			if(cursor == tagEnd)
+				return false;
+
+			attrBegin = pos;
+
+			if(lowerHTML[cursor] == '"' || lowerHTML[cursor] == '\'')
+			{
+				valueBegin = cursor + 1;
+				valueEnd = lowerHTML.find(lowerHTML[cursor], valueBegin);
+
+				if(valueEnd >= tagEnd)
+					return false;
+
+				attrEnd = valueEnd + 1;
+			}
+			else
+			{
+				valueBegin = cursor;
+				valueEnd = cursor;
+
+				while(valueEnd < tagEnd && !isspace((unsigned char)lowerHTML[valueEnd]))
+					valueEnd++;
+
+				attrEnd = valueEnd;
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+}
+
+void NaviManager::preloadResources(const std::string& groupName, const std::string& pattern)
+{
+	Ogre::StringVectorPtr names = Ogre::ResourceGroupManager::getSingleton().findResourceNames(groupName, pattern);
+	size_t totalSize = 0;
+
+	for(Ogre::StringVector::const_iterator i = names->begin(); i != names->end(); ++i)
+	{
+		Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(*i, groupName);
+		std::string& data = resourceCache[toResourceKey(*i)];
+		data = stream->getAsString();
+		totalSize += data.size();
+	}
+
+	pageCache.clear();
+
+	logTemplate("NaviManager: Preloaded ? resources (? KB) from resource group '?'.", Args(names->size())(totalSize / 1024)(groupName));
+}
+
+void NaviManager::addResource(const std::string& name, const std::string& data)
+{
+	resourceCache[toResourceKey(name)] = data;
+	pageCache.clear();
+}
+
+void NaviManager::clearResources()
+{
+	resourceCache.clear();
+	pageCache.clear();
+}
+
+size_t NaviManager::getResourceCacheSize()
+{
+	size_t size = 0;
+
+	for(std::map<std::string, std::string>::const_iterator i = resourceCache.begin(); i != resourceCache.end(); ++i)
+		size += i->second.size();
+
+	for(std::map<std::string, std::string>::const_iterator i = pageCache.begin(); i != pageCache.end(); ++i)
+		size += i->second.size();
+
+	return size;
+}
+
+const std::string* NaviManager::getCachedPage(const std::string& file)
+{
+	std::string key = toResourceKey(file);
+
+	std::map<std::string, std::string>::const_iterator page = pageCache.find(key);
+	if(page != pageCache.end())
+		return &page->second;
+
+	std::map<std::string, std::string>::const_iterator source = resourceCache.find(key);
+	if(source == resourceCache.end())
+		return 0;
+
+	std::string directory = getDirectory(normalizePath(file));
+	std::string& result = pageCache[key];
+	inlineResources(source->second, directory, result);
+	insertBaseURL(result, baseDirectoryURL + encodePath(directory));
+
+	return &result;
+}
+
+const std::string* NaviManager::findResource(const std::string& directory, const std::string& url)
+{
+	// Only relative URLs can refer to the resource cache
+	if(!isRelativeURL(url))
+		return 0;
+
+	std::string path = url.substr(0, url.find_first_of("?#"));
+	std::map<std::string, std::string>::const_iterator i = resourceCache.find(toResourceKey(directory + path));
+
+	return i == resourceCache.end() ? 0 : &i->second;
+}
+
+void NaviManager::inlineResources(const std::string& html, const std::string& directory, std::string& result)
+{
+	const std::string lowerHTML = lowerString(html);
+	size_t attrBegin, attrEnd, valueBegin, valueEnd;
+	size_t copied = 0;
+
+	result.clear();
+	result.reserve(html.size());
+
+	for(size_t tagBegin = lowerHTML.find('<'); tagBegin != std::string::npos; tagBegin = lowerHTML.find('<', tagBegin + 1))
+	{
+		size_t tagEnd = lowerHTML.find('>', tagBegin);
+		if(tagEnd == std::string::npos)
+			break;
+
+		if(lowerHTML.compare(tagBegin, 7, "<script") == 0 && isspace((unsigned char)lowerHTML[tagBegin + 7]))
+		{
+			size_t closeBegin = lowerHTML.find("</script", tagEnd);
+			size_t closeEnd = lowerHTML.find('>', closeBegin);
+
+			if(closeEnd == std::string::npos || !findAttribute(lowerHTML, tagBegin, tagEnd, "src", attrBegin, attrEnd, valueBegin, valueEnd))
+				continue;
+
+			const std::string* script = findResource(directory, html.substr(valueBegin, valueEnd - valueBegin));
+			if(!script)
+				continue;
+
+			std::string escapedScript = *script;
+			escapeClosingTag(escapedScript, "</script");
+
+			// Keep the tag without its 'src' attribute
+			result.append(html, copied, attrBegin - copied);
+			result.append(html, attrEnd, tagEnd + 1 - attrEnd);
+			result += escapedScript;
+			result += "</script>";
+
+			copied = closeEnd + 1;
+			tagBegin = closeEnd;
+		}
+		else if(lowerHTML.compare(tagBegin, 5, "<link") == 0 && isspace((unsigned char)lowerHTML[tagBegin + 5]))
+		{
+			if(!findAttribute(lowerHTML, tagBegin, tagEnd, "rel", attrBegin, attrEnd, valueBegin, valueEnd) ||
+				lowerHTML.compare(valueBegin, valueEnd - valueBegin, "stylesheet") != 0)
+				continue;
+
+			if(!findAttribute(lowerHTML, tagBegin, tagEnd, "href", attrBegin, attrEnd, valueBegin, valueEnd))
+				continue;
+
+			std::string url = html.substr(valueBegin, valueEnd - valueBegin);
+			const std::string* style = findResource(directory, url);
+			if(!style)
+				continue;
+
+			std::string rebasedStyle;
+			rebaseStylesheet(*style, baseDirectoryURL, encodePath(getDirectory(normalizePath(directory + url))), rebasedStyle);
+			escapeClosingTag(rebasedStyle, "</style");
+
+			result.append(html, copied, tagBegin - copied);
+			result += "<style type=\"text/css\">";
+			result += rebasedStyle;
+			result += "</style>";
+
+			copied = tagEnd + 1;
+		}
+	}
+
+	result.append(html, copied, std::string::npos);
+}
+
+const NaviFrameStats& NaviManager::getFrameStats() const
+{
+	return lastFrameStats;
+}
+
 bool NaviManager::focusNavi(int x, int y, Navi* selection)
 {
 	deFocusAllNavis();
@@ -299,6 +892,7 @@ bool NaviManager::focusNavi(int x, int y, Navi* selection)
 				sortedNavis.at(i)->overlay->setZOrder(sortedNavis.at(i+1)->overlay->getZOrder());
 			
 			sortedNavis.at(popIdx)->overlay->setZOrder(highestZ);
+			compositeDirty = true;
 		}
 	}
 
@@ -342,6 +936,673 @@ void NaviManager::deFocusAllNavis()
 	focusedNavi = 0;
 }
 
+void NaviManager::startTween(Navi* navi, TweenProperty property, float fromA, float fromB, float toA, float toB, 
+							 unsigned long duration, EasingCurve easing)
+{
+	stopTween(navi, property);
+
+	if(!duration)
+	{
+		navi->applyTween(property, toA, toB, true);
+		return;
+	}
+
+	Tween tween;
+	tween.navi = navi;
+	tween.property = property;
+	tween.from[0] = fromA;
+	tween.from[1] = fromB;
+	tween.to[0] = toA;
+	tween.to[1] = toB;
+	tween.startTime = animationTimer.getMilliseconds();
+	tween.duration = duration;
+	tween.easing = easing;
+
+	activeTweens.push_back(tween);
+}
+
+void NaviManager::stopTween(Navi* navi, TweenProperty property)
+{
+	for(std::vector<Tween>::iterator i = activeTweens.begin(); i != activeTweens.end(); ++i)
+	{
+		if(i->navi == navi && i->property == property)
+		{
+			*i = activeTweens.back();
+			activeTweens.pop_back();
+			return;
+		}
+	}
+}
+
+void NaviManager::stopAllTweens(Navi* navi)
+{
+	for(unsigned int i = 0; i < activeTweens.size();)
+	{
+		if(activeTweens[i].navi == navi)
+		{
+			activeTweens[i] = activeTweens.back();
+			activeTweens.pop_back();
+		}
+		else
+			++i;
+	}
+}
+
+void NaviManager::updateTweens()
+{
+	if(activeTweens.empty())
+		return;
+
+	unsigned long now = animationTimer.getMilliseconds();
+
+	for(unsigned int i = 0; i < activeTweens.size();)
+	{
+		Tween tween = activeTweens[i];
+
+		float progress = (float)(now - tween.startTime) / (float)tween.duration;
+		bool finished = progress >= 1;
+
+		if(finished)
+		{
+			progress = 1;
+			activeTweens[i] = activeTweens.back();
+			activeTweens.pop_back();
+		}
+		else
+			++i;
+
+		switch(tween.easing)
+		{
+		case EaseIn:
+			progress = progress * progress;
+			break;
+		case EaseOut:
+			progress = progress * (2 - progress);
+			break;
+		case EaseInOut:
+			progress = progress < 0.5f ? 2 * progress * progress : -1 + (4 - 2 * progress) * progress;
+			break;
+		default:
+			break;
+		}
+
+		tween.navi->applyTween(tween.property, tween.from[0] + (tween.to[0] - tween.from[0]) * progress,
+			tween.from[1] + (tween.to[1] - tween.from[1]) * progress, finished);
+	}
+}
+
+const std::string& NaviManager::getShaderProgram()
+{
+	if(!useShaders || !shadersSupported || shaderProgramName.size())
+		return shaderProgramName;
+
+	const Ogre::RenderSystemCapabilities* caps = Ogre::Root::getSingleton().getRenderSystem()->getCapabilities();
+	Ogre::HighLevelGpuProgramManager& programManager = Ogre::HighLevelGpuProgramManager::getSingleton();
+
+	std::string language = programManager.isLanguageSupported("hlsl") ? "hlsl" : 
+		programManager.isLanguageSupported("glsl") ? "glsl" : "";
+
+	if(!caps->hasCapability(Ogre::RSC_FRAGMENT_PROGRAM) || language.empty() || caps->getNumTextureUnits() < 2)
+	{
+		shadersSupported = false;
+		Ogre::LogManager::getSingleton().logMessage("NaviManager: Fragment programs are unsupported, falling back to fixed-function Navi materials.");
+		return shaderProgramName;
+	}
+
+	Ogre::HighLevelGpuProgramPtr program = programManager.createProgram("NaviFragmentProgram", 
+		Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, language, Ogre::GPT_FRAGMENT_PROGRAM);
+
+	if(language == "hlsl")
+	{
+		program->setSource(naviProgramHLSL);
+		program->setParameter("entry_point", "main");
+		program->setParameter("target", "ps_2_0");
+	}
+	else
+	{
+		program->setSource(naviProgramGLSL);
+	}
+
+	program->load();
+
+	if(!program->isSupported())
+	{
+		programManager.remove("NaviFragmentProgram");
+		shadersSupported = false;
+		Ogre::LogManager::getSingleton().logMessage("NaviManager: The Navi fragment program failed to compile, falling back to fixed-function Navi materials.");
+		return shaderProgramName;
+	}
+
+	if(language == "glsl")
+	{
+		program->getDefaultParameters()->setNamedConstant("baseMap", 0);
+		program->getDefaultParameters()->setNamedConstant("maskMap", 1);
+	}
+
+	// Navis without a mask sample this instead so that every Navi shares the same program and texture unit layout
+	Ogre::TexturePtr whiteMask = Ogre::TextureManager::getSingleton().createManual("NaviWhiteMaskTexture", 
+		Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, 1, 1, 0, Ogre::PF_BYTE_A, Ogre::TU_STATIC_WRITE_ONLY);
+
+	Ogre::HardwarePixelBufferSharedPtr pixelBuffer = whiteMask->getBuffer();
+	pixelBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD);
+	const Ogre::PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+	memset(pixelBox.data, 255, Ogre::PixelUtil::getNumElemBytes(pixelBox.format));
+	pixelBuffer->unlock();
+
+	shaderProgramName = "NaviFragmentProgram";
+
+	return shaderProgramName;
+}
+
+const std::string& NaviManager::acquireSharedMaterial(const std::string& textureName, const std::string& maskTextureName)
+{
+	SharedMaterial& shared = sharedMaterials[textureName + "|" + maskTextureName];
+
+	if(shared.numNavis++)
+		return shared.materialName;
+
+	shared.materialName = "NaviSharedMaterial" + Ogre::StringConverter::toString(sharedMaterialCounter++);
+
+	Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create(shared.materialName, 
+		Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	Ogre::Pass* pass = material->getTechnique(0)->getPass(0);
+	if(compositing)
+		pass->setSeparateSceneBlending(Ogre::SBF_SOURCE_ALPHA, Ogre::SBF_ONE_MINUS_SOURCE_ALPHA, 
+			Ogre::SBF_ONE, Ogre::SBF_ONE_MINUS_SOURCE_ALPHA);
+	else
+		pass->setSceneBlending(Ogre::SBT_TRANSPARENT_ALPHA);
+	pass->setDepthWriteEnabled(false);
+	pass->setFragmentProgram(shaderProgramName);
+	pass->createTextureUnitState(textureName)->setTextureFiltering(Ogre::FO_NONE, Ogre::FO_NONE, Ogre::FO_NONE);
+	pass->createTextureUnitState(maskTextureName)->setTextureFiltering(Ogre::FO_NONE, Ogre::FO_NONE, Ogre::FO_NONE);
+
+	// Each Navi passes its opacity and texture rects through the custom parameters of its panel and composite quad
+	Ogre::GpuProgramParametersSharedPtr params = pass->getFragmentProgramParameters();
+	params->setNamedAutoConstant("naviParams", Ogre::GpuProgramParameters::ACT_CUSTOM, Navi::ShaderNaviParams);
+	params->setNamedAutoConstant("baseRect", Ogre::GpuProgramParameters::ACT_CUSTOM, Navi::ShaderBaseRect);
+	params->setNamedAutoConstant("maskRect", Ogre::GpuProgramParameters::ACT_CUSTOM, Navi::ShaderMaskRect);
+
+	frameStats.materialStateChanges++;
+
+	return shared.materialName;
+}
+
+void NaviManager::releaseSharedMaterial(const std::string& materialName)
+{
+	for(std::map<std::string, SharedMaterial>::iterator i = sharedMaterials.begin(); i != sharedMaterials.end(); ++i)
+	{
+		if(i->second.materialName != materialName)
+			continue;
+
+		if(--i->second.numNavis == 0)
+		{
+			Ogre::MaterialManager::getSingleton().remove(materialName);
+			sharedMaterials.erase(i);
+		}
+
+		return;
+	}
+}
+
+void NaviManager::createCompositeLayer()
+{
+	compositeSceneMgr = Ogre::Root::getSingleton().createSceneManager(Ogre::ST_GENERIC, "NaviCompositeSceneManager");
+
+	compositeCamera = compositeSceneMgr->createCamera("NaviCompositeCamera");
+	compositeCamera->setProjectionType(Ogre::PT_ORTHOGRAPHIC);
+	compositeCamera->setNearClipDistance(1);
+	compositeCamera->setFarClipDistance(1001);
+
+	Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create("NaviCompositeMaterial", 
+		Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	Ogre::Pass* pass = material->getTechnique(0)->getPass(0);
+	pass->setSceneBlending(Ogre::SBF_ONE, Ogre::SBF_ONE_MINUS_SOURCE_ALPHA);
+	pass->setDepthWriteEnabled(false);
+	pass->setLightingEnabled(false);
+
+	createCompositeTexture();
+
+	Ogre::OverlayManager& overlayManager = Ogre::OverlayManager::getSingleton();
+
+	compositePanel = static_cast<Ogre::PanelOverlayElement*>(overlayManager.createOverlayElement("Panel", "NaviCompositePanel"));
+	compositePanel->setMetricsMode(Ogre::GMM_PIXELS);
+	compositePanel->setMaterialName("NaviCompositeMaterial");
+	compositePanel->setPosition(0, 0);
+	compositePanel->setDimensions(compositeWidth, compositeHeight);
+
+	compositeOverlay = overlayManager.create("NaviCompositeOverlay");
+	compositeOverlay->add2D(compositePanel);
+	compositeOverlay->show();
+
+	compositeDirty = true;
+}
+
+void NaviManager::createCompositeTexture()
+{
+	compositeWidth = renderWindow->getWidth();
+	compositeHeight = renderWindow->getHeight();
+
+	compositeCamera->setOrthoWindow(compositeWidth, compositeHeight);
+
+	// Navis are composited with premultiplied alpha, the layer is cleared to transparent black
+	Ogre::TexturePtr texture = Ogre::TextureManager::getSingleton().createManual("NaviCompositeTexture", 
+		Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, compositeWidth, compositeHeight, 
+		0, Ogre::PF_BYTE_BGRA, Ogre::TU_RENDERTARGET);
+
+	Ogre::RenderTexture* renderTexture = texture->getBuffer()->getRenderTarget();
+	renderTexture->setAutoUpdated(false);
+
+	Ogre::Viewport* viewport = renderTexture->addViewport(compositeCamera);
+	viewport->setClearEveryFrame(true);
+	viewport->setBackgroundColour(Ogre::ColourValue(0, 0, 0, 0));
+	viewport->setOverlaysEnabled(false);
+	viewport->setSkiesEnabled(false);
+	viewport->setShadowsEnabled(false);
+
+	Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().getByName("NaviCompositeMaterial");
+	Ogre::Pass* pass = material->getTechnique(0)->getPass(0);
+
+	if(pass->getNumTextureUnitStates())
+		pass->getTextureUnitState(0)->setTextureName("NaviCompositeTexture");
+	else
+		pass->createTextureUnitState("NaviCompositeTexture")->setTextureFiltering(Ogre::FO_NONE, Ogre::FO_NONE, Ogre::FO_NONE);
+}
+
+void NaviManager::destroyCompositeTexture()
+{
+	Ogre::TexturePtr texture = Ogre::TextureManager::getSingleton().getByName("NaviCompositeTexture");
+
+	if(!texture.isNull())
+	{
+		texture->getBuffer()->getRenderTarget()->removeAllViewports();
+		Ogre::TextureManager::getSingleton().remove("NaviCompositeTexture");
+	}
+}
+
+void NaviManager::destroyCompositeLayer()
+{
+	if(compositeOverlay)
+	{
+		compositeOverlay->remove2D(compositePanel);
+		Ogre::OverlayManager::getSingleton().destroyOverlayElement(compositePanel);
+		Ogre::OverlayManager::getSingleton().destroy(compositeOverlay);
+		compositeOverlay = 0;
+		compositePanel = 0;
+	}
+
+	destroyCompositeTexture();
+	Ogre::MaterialManager::getSingleton().remove("NaviCompositeMaterial");
+
+	if(compositeSceneMgr)
+	{
+		compositeSceneMgr->destroyCamera(compositeCamera);
+		Ogre::Root::getSingleton().destroySceneManager(compositeSceneMgr);
+		compositeSceneMgr = 0;
+		compositeCamera = 0;
+	}
+}
+
+void NaviManager::attachToComposite(Navi* navi)
+{
+	Ogre::Real u1, v1, u2, v2;
+	navi->getDerivedUV(u1, v1, u2, v2);
+
+	navi->compositeQuad = compositeSceneMgr->createManualObject(navi->naviName + "CompositeQuad");
+	navi->compositeQuad->setDynamic(true);
+	navi->compositeQuad->begin(navi->getMaterialName());
+	navi->compositeQuad->position(0, 0, 0);
+	navi->compositeQuad->textureCoord(u1, v1);
+	navi->compositeQuad->position(0, -1, 0);
+	navi->compositeQuad->textureCoord(u1, v2);
+	navi->compositeQuad->position(1, -1, 0);
+	navi->compositeQuad->textureCoord(u2, v2);
+	navi->compositeQuad->position(1, 0, 0);
+	navi->compositeQuad->textureCoord(u2, v1);
+	navi->compositeQuad->quad(0, 1, 2, 3);
+	navi->compositeQuad->end();
+
+	if(navi->sharingMaterial)
+		navi->applyShaderConstants(navi->compositeQuad->getSection(0));
+
+	navi->compositeNode = compositeSceneMgr->getRootSceneNode()->createChildSceneNode();
+	navi->compositeNode->attachObject(navi->compositeQuad);
+
+	// Accumulate coverage in the alpha channel so the layer can be drawn with premultiplied alpha
+	navi->matPass->setSeparateSceneBlending(Ogre::SBF_SOURCE_ALPHA, Ogre::SBF_ONE_MINUS_SOURCE_ALPHA, 
+		Ogre::SBF_ONE, Ogre::SBF_ONE_MINUS_SOURCE_ALPHA);
+	frameStats.materialStateChanges++;
+
+	compositeDirty = true;
+}
+
+void NaviManager::detachFromComposite(Navi* navi)
+{
+	if(!navi->compositeQuad)
+		return;
+
+	navi->compositeNode->detachAllObjects();
+	compositeSceneMgr->destroySceneNode(navi->compositeNode);
+	compositeSceneMgr->destroyManualObject(navi->compositeQuad);
+	navi->compositeNode = 0;
+	navi->compositeQuad = 0;
+
+	// A shared material keeps compositing's blending while the other Navis using it are still in the layer
+	if(!navi->sharingMaterial || !compositing)
+	{
+		navi->matPass->setSceneBlending(Ogre::SBT_TRANSPARENT_ALPHA);
+		frameStats.materialStateChanges++;
+	}
+
+	compositeDirty = true;
+}
+
+void NaviManager::updateCompositeLayer()
+{
+	if(!compositing)
+		return;
+
+	if(compositeWidth != renderWindow->getWidth() || compositeHeight != renderWindow->getHeight())
+	{
+		destroyCompositeTexture();
+		createCompositeTexture();
+		compositePanel->setDimensions(compositeWidth, compositeHeight);
+		compositeDirty = true;
+	}
+
+	if(!compositeDirty)
+		return;
+
+	unsigned short highestZ = 0;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
+		if(iter->second->isMaterial)
+			continue;
+
+		iter->second->updateCompositeQuad(compositeWidth, compositeHeight);
+		highestZ = std::max(highestZ, iter->second->overlay->getZOrder());
+	}
+
+	compositeOverlay->setZOrder(highestZ);
+
+	Ogre::TextureManager::getSingleton().getByName("NaviCompositeTexture")->getBuffer()->getRenderTarget()->update();
+	frameStats.compositeUpdates++;
+
+	compositeDirty = false;
+}
+
+void NaviManager::updateOcclusion()
+{
+	std::vector<std::pair<unsigned short, Navi*> > sortedNavis;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
+		iter->second->isOccluded = false;
+
+		if(!iter->second->isMaterial && !iter->second->okayToDelete && iter->second->isVisible)
+			sortedNavis.push_back(std::make_pair(iter->second->overlay->getZOrder(), iter->second));
+	}
+
+	if(sortedNavis.size() < 2)
+		return;
+
+	// Highest Z-Order first: a Navi can only be occluded by the Navis that precede it
+	std::sort(sortedNavis.rbegin(), sortedNavis.rend());
+
+	std::vector<OcclusionRect> region;
+
+	for(unsigned int i = 1; i < sortedNavis.size(); i++)
+	{
+		Navi* navi = sortedNavis[i].second;
+
+		region.clear();
+		region.push_back(getPanelRect(navi->panel));
+
+		for(unsigned int j = 0; j < i && region.size(); j++)
+			if(sortedNavis[j].first > sortedNavis[i].first && sortedNavis[j].second->isOpaque())
+				subtractRect(region, getPanelRect(sortedNavis[j].second->panel));
+
+		navi->isOccluded = region.empty();
+	}
+}
+
+void NaviManager::scheduleRestores()
+{
+	std::vector<std::pair<unsigned int, Navi*> > pending;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
+		Navi* navi = iter->second;
+
+		// Navis that can't be seen are restored by their first regular update once they're visible again
+		if(!navi->awaitingRestore || navi->needsRefresh || navi->okayToDelete || !navi->isShowing())
+			continue;
+
+		unsigned int priority = navi->isMaterial ? 0 : navi->overlay->getZOrder() + 1;
+		if(navi == focusedNavi)
+			priority = 0xFFFF + 1;
+
+		pending.push_back(std::make_pair(priority, navi));
+	}
+
+	if(pending.empty())
+		return;
+
+	std::sort(pending.rbegin(), pending.rend());
+
+	unsigned int budget = restoreBudget;
+
+	for(unsigned int i = 0; i < pending.size(); i++)
+	{
+		Navi* navi = pending[i].second;
+		unsigned int pixels = navi->renderWidth * navi->renderHeight;
+
+		if(i && pixels > budget)
+			break;
+
+		navi->needsRefresh = true;
+		budget -= std::min(pixels, budget);
+	}
+}
+
+void NaviManager::enforceMemoryBudget()
+{
+	if(!textureMemoryBudget && !systemMemoryBudget)
+		return;
+
+	size_t textureMemory, requiredMemory;
+	getTextureMemoryUsage(textureMemory, requiredMemory);
+	size_t systemMemory = getSystemMemoryUsage();
+
+	if((!textureMemoryBudget || textureMemory <= textureMemoryBudget) && (!systemMemoryBudget || systemMemory <= systemMemoryBudget))
+		return;
+
+	// Anything that wasn't visible this frame may go, least-recently-visible first. NaviMaterials are never
+	// evicted: their material may still be bound to entities in the scene even while the Navi is hidden.
+	std::vector<std::pair<unsigned long, Navi*> > candidates;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+		if(!iter->second->isMaterial && !iter->second->textureEvicted && !iter->second->okayToDelete && iter->second->lastVisibleFrame != frameCounter)
+			candidates.push_back(std::make_pair(iter->second->lastVisibleFrame, iter->second));
+
+	std::sort(candidates.begin(), candidates.end());
+
+	for(unsigned int i = 0; i < candidates.size(); i++)
+	{
+		if((!textureMemoryBudget || textureMemory <= textureMemoryBudget) && (!systemMemoryBudget || systemMemory <= systemMemoryBudget))
+			break;
+
+		Navi* navi = candidates[i].second;
+		navi->evictTexture();
+
+		getTextureMemoryUsage(textureMemory, requiredMemory);
+		systemMemory = getSystemMemoryUsage();
+
+		logTemplate("NaviManager: Evicted the texture of Navi '?' to stay within the memory budget. Texture memory: ? of ? KB, system memory: ? of ? KB.",
+			Args(navi->naviName)(textureMemory / 1024)(textureMemoryBudget / 1024)(systemMemory / 1024)(systemMemoryBudget / 1024));
+	}
+}
+
+bool NaviManager::allocateTextureRect(unsigned short width, unsigned short height, std::string& textureName,
+									  unsigned short& left, unsigned short& top, unsigned short& allocWidth, unsigned short& allocHeight)
+{
+	if(!texturePacking || width > texturePageSize || height > texturePageSize)
+		return false;
+
+	// Leave a one texel gutter so that filtering never picks up a neighbouring Navi
+	allocWidth = std::min<unsigned short>(width + 1, texturePageSize);
+	allocHeight = std::min<unsigned short>(height + 1, texturePageSize);
+
+	TexturePage* bestPage = 0;
+	unsigned int bestRect = 0;
+	unsigned int bestArea = 0;
+
+	// Best-area-fit over the free rectangles of every page
+	for(std::vector<TexturePage>::iterator page = texturePages.begin(); page != texturePages.end(); ++page)
+	{
+		for(unsigned int i = 0; i < page->freeRects.size(); i++)
+		{
+			const TexturePageRect& rect = page->freeRects[i];
+			unsigned int area = rect.width * rect.height;
+
+			if(rect.width >= allocWidth && rect.height >= allocHeight && (!bestPage || area < bestArea))
+			{
+				bestPage = &*page;
+				bestRect = i;
+				bestArea = area;
+			}
+		}
+	}
+
+	if(!bestPage)
+	{
+		TexturePage page;
+		page.textureName = "NaviTexturePage" + Ogre::StringConverter::toString(texturePageCounter++);
+		page.size = texturePageSize;
+		page.numNavis = 0;
+
+		page.freeRects.push_back(TexturePageRect(0, 0, texturePageSize, texturePageSize));
+
+		// Partially locked by each Navi, so this can't be discardable
+		Ogre::TextureManager::getSingleton().createManual(page.textureName, 
+			Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, texturePageSize, texturePageSize, 
+			0, Ogre::PF_BYTE_BGR, Ogre::TU_DYNAMIC_WRITE_ONLY, this);
+
+		texturePages.push_back(page);
+		bestPage = &texturePages.back();
+		bestRect = 0;
+	}
+
+	TexturePageRect rect = bestPage->freeRects[bestRect];
+	bestPage->freeRects.erase(bestPage->freeRects.begin() + bestRect);
+
+	// Guillotine split along the shorter leftover axis
+	TexturePageRect right(rect.left + allocWidth, rect.top, rect.width - allocWidth, rect.height);
+	TexturePageRect bottom(rect.left, rect.top + allocHeight, allocWidth, rect.height - allocHeight);
+
+	if(rect.width - allocWidth < rect.height - allocHeight)
+	{
+		right.height = allocHeight;
+		bottom.width = rect.width;
+	}
+
+	if(right.width && right.height)
+		bestPage->freeRects.push_back(right);
+	if(bottom.width && bottom.height)
+		bestPage->freeRects.push_back(bottom);
+
+	bestPage->numNavis++;
+
+	textureName = bestPage->textureName;
+	left = rect.left;
+	top = rect.top;
+
+	return true;
+}
+
+void NaviManager::releaseTextureRect(const std::string& textureName, unsigned short left, unsigned short top, 
+									 unsigned short width, unsigned short height)
+{
+	for(std::vector<TexturePage>::iterator page = texturePages.begin(); page != texturePages.end(); ++page)
+	{
+		if(page->textureName != textureName)
+			continue;
+
+		if(!--page->numNavis)
+		{
+			Ogre::TextureManager::getSingleton().remove(page->textureName);
+			texturePages.erase(page);
+			return;
+		}
+
+		page->freeRects.push_back(TexturePageRect(left, top, width, height));
+
+		// Merge free rectangles that share a full edge so that the space can be reused by larger Navis
+		bool merged = true;
+		while(merged)
+		{
+			merged = false;
+
+			for(unsigned int i = 0; i < page->freeRects.size() && !merged; i++)
+			{
+				for(unsigned int j = 0; j < page->freeRects.size() && !merged; j++)
+				{
+					TexturePageRect& a = page->freeRects[i];
+					const TexturePageRect& b = page->freeRects[j];
+
+					if(i == j)
+						continue;
+
+					if(a.top == b.top && a.height == b.height && a.left + a.width == b.left)
+						a.width += b.width;
+					else if(a.left == b.left && a.width == b.width && a.top + a.height == b.top)
+						a.height += b.height;
+					else
+						continue;
+
+					page->freeRects.erase(page->freeRects.begin() + j);
+					merged = true;
+				}
+			}
+		}
+
+		return;
+	}
+}
+
+// This is for when the rendering device has a hiccup and loses a texture page
+void NaviManager::loadResource(Ogre::Resource* resource)
+{
+	Ogre::Texture* tex = static_cast<Ogre::Texture*>(resource);
+	unsigned short size = texturePageSize;
+
+	for(std::vector<TexturePage>::iterator page = texturePages.begin(); page != texturePages.end(); ++page)
+		if(page->textureName == tex->getName())
+			size = page->size;
+
+	tex->setTextureType(Ogre::TEX_TYPE_2D);
+	tex->setWidth(size);
+	tex->setHeight(size);
+	tex->setNumMipmaps(0);
+	tex->setFormat(Ogre::PF_BYTE_BGR);
+	tex->setUsage(Ogre::TU_DYNAMIC_WRITE_ONLY);
+	tex->createInternalResources();
+
+	// Every Navi on this page has to be re-uploaded from its shadow surface or re-rendered (see NaviManager::scheduleRestores)
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
+		Navi* navi = iter->second;
+
+		if(!navi->texturePacked || navi->textureName != tex->getName() || !navi->lastUpdateTime)
+			continue;
+
+		if(navi->shadowSurface)
+			navi->uploadShadowSurface(0, 0, navi->renderWidth, navi->renderHeight);
+		else
+			navi->beginRestore();
+	}
+}
+
 void NaviManager::handleKeyMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
 	if(focusedNavi)
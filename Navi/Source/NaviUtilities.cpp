@@ -23,14 +23,104 @@
 #include "NaviUtilities.h"
 #include "NaviManager.h"
 #include <ctype.h>
+#include <float.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <list>
+#include <new>
+#include <vector>
 #include <utf8.h>
+#include <OgrePlatformInformation.h>
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 #include <direct.h>
-#include <stdlib.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#if OGRE_PLATFORM == OGRE_PLATFORM_APPLE
+#include <xlocale.h>
+#endif
+#endif
+#if OGRE_CPU == OGRE_CPU_X86
+#include <intrin.h>
+#include <emmintrin.h>
+// SSSE3 intrinsics need VC9, AVX2 intrinsics VC11; older compilers only get the SSE2 paths
+#if _MSC_VER >= 1500
+#define NAVI_USE_SSSE3
+#include <tmmintrin.h>
+#endif
+#if _MSC_VER >= 1700
+#define NAVI_USE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+// Ogre's LogManager may only be used from another thread if Ogre was built with thread support
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32 && OGRE_THREAD_SUPPORT
+#define NAVI_LOG_WRITER_THREAD
 #endif
 
 using namespace NaviLibrary;
 
+#if OGRE_CPU == OGRE_CPU_X86
+namespace
+{
+	struct CpuFeatures
+	{
+		bool sse2;
+		bool ssse3;
+		bool avx2;
+	};
+
+	/**
+	* Queries CPUID directly: Ogre's PlatformInformation doesn't report SSSE3 or AVX2.
+	*/
+	CpuFeatures detectCpuFeatures()
+	{
+		CpuFeatures features = { false, false, false };
+		int info[4];
+
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		if(maxLeaf < 1)
+			return features;
+
+		__cpuid(info, 1);
+		features.sse2 = (info[3] & (1 << 26)) != 0;
+		features.ssse3 = (info[2] & (1 << 9)) != 0;
+
+#ifdef NAVI_USE_AVX2
+		// The OS also has to save the upper halves of the YMM registers (OSXSAVE set, XCR0 bits 1 and 2)
+		if(maxLeaf >= 7 && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			features.avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#endif
+
+		return features;
+	}
+
+	// Detected during static initialization, before any other thread can call into the library
+	const CpuFeatures cpuFeatures = detectCpuFeatures();
+
+	inline bool hasSSE2()
+	{
+		return cpuFeatures.sse2;
+	}
+
+	inline bool hasSSSE3()
+	{
+		return cpuFeatures.ssse3;
+	}
+
+	inline bool hasAVX2()
+	{
+		return cpuFeatures.avx2;
+	}
+}
+#endif
+
 std::string NaviUtilities::getCurrentWorkingDirectory()
 {
 	std::string workingDirectory = "";
@@ -53,303 +143,2344 @@ std::string NaviUtilities::lowerString(std::string strToLower)
 
 bool NaviUtilities::isNumeric(const std::string &numberString)
 {
-	std::istringstream converter(numberString);
 	int test;
 
-	return isPrefixed(numberString, "true") || isPrefixed(numberString, "false") ? true : !(converter >> test).fail();
+	return parseNumber(numberString.c_str(), test) != 0;
 }
 
-std::wstring NaviUtilities::toWide(const std::string &stringToConvert)
+namespace
 {
-	size_t size = mbstowcs(0, stringToConvert.c_str(), 0) + 1;
-	wchar_t *temp = new wchar_t[size];
-	mbstowcs(temp, stringToConvert.c_str(), size);
-	std::wstring result(temp);
-	delete[] temp;
-	return result;
-}
+	const char digitPairs[] = 
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
 
-std::string NaviUtilities::toMultibyte(const std::wstring &wstringToConvert)
-{
-	size_t size = wcstombs(0, wstringToConvert.c_str(), 0) + 1;
-	char *temp = new char[size];
-	wcstombs(temp, wstringToConvert.c_str(), size);
-	std::string result(temp);
-	delete[] temp;
-	return result;
-}
+	const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
 
-void NaviUtilities::setLocale(const std::string &localeLanguage)
-{
-	setlocale(LC_CTYPE, localeLanguage.c_str());
-}
+	template<class UnsignedType>
+	size_t formatInteger(UnsignedType magnitude, bool negative, char* buffer)
+	{
+		char digits[NaviUtilities::NumberBufferSize];
+		char* end = digits + sizeof(digits);
+		char* start = end;
 
-int NaviUtilities::replaceAll(std::string &sourceStr, const std::string &replaceWhat, const std::string &replaceWith)
-{
-	int count = 0;
+		// Two digits at a time, from the back
+		while(magnitude >= 100)
+		{
+			const char* pair = digitPairs + (magnitude % 100) * 2;
+			magnitude /= 100;
+			*--start = pair[1];
+			*--start = pair[0];
+		}
 
-	for(size_t i = sourceStr.find(replaceWhat); i != std::string::npos; i = sourceStr.find(replaceWhat, i + replaceWith.length()))
+		if(magnitude >= 10)
+		{
+			*--start = digitPairs[magnitude * 2 + 1];
+			*--start = digitPairs[magnitude * 2];
+		}
+		else
+			*--start = (char)('0' + magnitude);
+
+		if(negative)
+			*--start = '-';
+
+		size_t length = end - start;
+		memcpy(buffer, start, length);
+		buffer[length] = 0;
+
+		return length;
+	}
+
+	template<class SignedType, class UnsignedType>
+	size_t formatSigned(SignedType value, char* buffer)
 	{
-		sourceStr.erase(i, replaceWhat.length());
-		sourceStr.insert(i, replaceWith);
-		++count;
+		UnsignedType magnitude = value < 0 ? (UnsignedType)0 - (UnsignedType)value : (UnsignedType)value;
+
+		return formatInteger<UnsignedType>(magnitude, value < 0, buffer);
 	}
 
-	return count;
-}
+	/**
+	* printf("%g") and strtod in the "C" locale, whatever locale the application has set: the numbers we write
+	* go into Javascript and are parsed back, they must always use '.' as the decimal point.
+	*/
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	const _locale_t numericLocale = _create_locale(LC_NUMERIC, "C");
 
-std::vector<std::string> NaviUtilities::split(const std::string &sourceStr, const std::string &delimiter, bool ignoreEmpty)
-{
-	std::vector<std::string> resultVector;
+	size_t printFloatingPoint(double value, char* buffer, int precision)
+	{
+		return _sprintf_l(buffer, "%.*g", numericLocale, precision, value);
+	}
 
-	size_t idxA = 0;
-	size_t idxB = sourceStr.find(delimiter);
-	std::string tempStr;
-	bool done = false;
+	double parseFloatingPoint(const char* str)
+	{
+		return _strtod_l(str, 0, numericLocale);
+	}
+#else
+	const locale_t numericLocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
 
-	while(!done)
+	size_t printFloatingPoint(double value, char* buffer, int precision)
 	{
-		if(idxB != std::string::npos)
-		{
-			tempStr = sourceStr.substr(idxA, idxB-idxA);
-			idxA = idxB + delimiter.length();
-			idxB = sourceStr.find(delimiter, idxA);
-		}
-		else
+		locale_t previous = uselocale(numericLocale);
+		int length = sprintf(buffer, "%.*g", precision, value);
+		uselocale(previous);
+
+		return length;
+	}
+
+	double parseFloatingPoint(const char* str)
+	{
+		locale_t previous = uselocale(numericLocale);
+		double value = strtod(str, 0);
+		uselocale(previous);
+
+		return value;
+	}
+#endif
+
+	/**
+	* Writes the shortest representation, between minDigits and maxDigits significant digits, that parses back
+	* to exactly the same value. maxDigits (9 for a float, 17 for a double) always does.
+	*/
+	template<class FloatType>
+	size_t formatShortest(FloatType value, char* buffer, int minDigits, int maxDigits)
+	{
+		for(int precision = minDigits; precision < maxDigits; precision++)
 		{
-			tempStr = sourceStr.substr(idxA);
-			done = true;
+			size_t length = printFloatingPoint(value, buffer, precision);
+
+			if((FloatType)parseFloatingPoint(buffer) == value)
+				return length;
 		}
 
-		if(!(ignoreEmpty && tempStr.empty()))
-			resultVector.push_back(tempStr);
+		return printFloatingPoint(value, buffer, maxDigits);
 	}
 
-	return resultVector;
-}
+	const char* skipWhitespace(const char* str)
+	{
+		while(*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r' || *str == '\v' || *str == '\f')
+			str++;
 
-std::map<std::string,std::string> NaviUtilities::splitToMap(const std::string &sourceStr, const std::string &pairDelimiter, const std::string &keyValueDelimiter, bool ignoreEmpty)
-{
-	std::map<std::string,std::string> resultMap;
+		return str;
+	}
+
+	size_t parseBoolean(const char* str, bool& result)
+	{
+		const char* word = (*str == 't' || *str == 'T') ? "true" : "false";
+		size_t length = 0;
 
-	size_t idx = 0;
-	std::string strA, strB;
+		while(word[length] && tolower(str[length]) == word[length])
+			length++;
 
-	std::vector<std::string> tempVector = split(sourceStr, pairDelimiter);
+		if(word[length])
+			return 0;
 
-	for(std::vector<std::string>::const_iterator i = tempVector.begin(); i != tempVector.end(); i++)
+		result = *word == 't';
+		return length;
+	}
+
+	template<class UnsignedType>
+	size_t parseDigits(const char* str, UnsignedType& result)
 	{
-		idx = i->find(keyValueDelimiter);
-		if(idx != std::string::npos)
+		const UnsignedType maxValue = (UnsignedType)-1;
+		UnsignedType value = 0;
+		size_t length = 0;
+
+		for(unsigned int digit = str[0] - '0'; digit < 10; digit = str[++length] - '0')
 		{
-			strA = i->substr(0, idx);
-			strB = i->substr(idx + keyValueDelimiter.length());
+			if(value > (maxValue - digit) / 10)
+				return 0;
 
-			if(!(ignoreEmpty && (strA.empty() || strB.empty())) && !resultMap.count(strA))
-				resultMap[strA] = strB;
+			value = value * 10 + digit;
 		}
+
+		result = value;
+		return length;
 	}
 
-	return resultMap;
-}
+	template<class SignedType, class UnsignedType>
+	size_t parseInteger(const char* numberString, SignedType& result, bool isSigned)
+	{
+		const char* str = skipWhitespace(numberString);
+		bool boolean;
 
-std::string NaviUtilities::join(const std::vector<std::string> &sourceVector, const std::string &delimiter, bool ignoreEmpty)
-{
-	std::string result = "";
+		if(size_t length = parseBoolean(str, boolean))
+		{
+			result = boolean;
+			return str + length - numberString;
+		}
 
-	for(std::vector<std::string>::const_iterator i = sourceVector.begin(); i != sourceVector.end(); i++)
-		if(!(ignoreEmpty && i->empty()))
-			result += result.length() ? delimiter + (*i) : (*i);
+		bool negative = *str == '-';
+		if(*str == '-' || *str == '+')
+			str++;
 
-	return result;
-}
+		UnsignedType magnitude;
+		size_t length = parseDigits(str, magnitude);
+		if(!length)
+			return 0;
 
-std::string NaviUtilities::joinFromMap(const std::map<std::string,std::string> &sourceMap, const std::string &pairDelimiter, const std::string &keyValueDelimiter, bool ignoreEmpty)
-{
-	std::string result = "";
+		if(isSigned)
+		{
+			UnsignedType limit = ((UnsignedType)-1) / 2;
+			if(magnitude > limit + (negative ? 1 : 0))
+				return 0;
+		}
 
-	for(std::map<std::string,std::string>::const_iterator i = sourceMap.begin(); i != sourceMap.end(); i++)
-		if(!(ignoreEmpty && (i->first.empty() || i->second.empty())))
-			result += result.length() ? pairDelimiter + i->first + keyValueDelimiter + i->second : i->first + keyValueDelimiter + i->second;
+		result = (SignedType)(negative ? (UnsignedType)0 - magnitude : magnitude);
+		return str + length - numberString;
+	}
 
-	return result;
-}
+	size_t parseFloatingPoint(const char* numberString, double& result)
+	{
+		const char* str = skipWhitespace(numberString);
+		bool boolean;
 
-NaviUtilities::MultiValue::MultiValue() { }
+		if(size_t length = parseBoolean(str, boolean))
+		{
+			result = boolean;
+			return str + length - numberString;
+		}
 
-NaviUtilities::MultiValue::MultiValue(const std::string &value) { *this = value; }
+		const char* start = str;
+		bool negative = *str == '-';
+		if(*str == '-' || *str == '+')
+			str++;
 
-NaviUtilities::MultiValue::MultiValue(const char *value) { *this = std::string(value); }
+		unsigned long long mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+		bool truncated = false;
 
-NaviUtilities::MultiValue::MultiValue(const std::wstring &value) { *this = value; }
+		for(; (unsigned int)(*str - '0') < 10; str++, anyDigits = true)
+		{
+			if(significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*str - '0');
+				if(mantissa)
+					significantDigits++;
+			}
+			else
+			{
+				truncated |= *str != '0';
+				exponent++;
+			}
+		}
 
-NaviUtilities::MultiValue::MultiValue(int value) { *this = value; }
+		if(*str == '.')
+		{
+			for(str++; (unsigned int)(*str - '0') < 10; str++, anyDigits = true)
+			{
+				if(significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*str - '0');
+					if(mantissa)
+						significantDigits++;
+					exponent--;
+				}
+				else
+					truncated |= *str != '0';
+			}
+		}
 
-NaviUtilities::MultiValue::MultiValue(size_t value) { *this = value; }
+		if(!anyDigits)
+			return 0;
 
-NaviUtilities::MultiValue::MultiValue(float value) { *this = value; }
+		if(*str == 'e' || *str == 'E')
+		{
+			const char* exponentStr = str + 1;
+			bool negativeExponent = *exponentStr == '-';
+			if(*exponentStr == '-' || *exponentStr == '+')
+				exponentStr++;
+
+			int explicitExponent = 0;
+			if((unsigned int)(*exponentStr - '0') < 10)
+			{
+				for(; (unsigned int)(*exponentStr - '0') < 10; exponentStr++)
+					if(explicitExponent < 10000)
+						explicitExponent = explicitExponent * 10 + (*exponentStr - '0');
+
+				exponent += negativeExponent ? -explicitExponent : explicitExponent;
+				str = exponentStr;
+			}
+		}
 
-NaviUtilities::MultiValue::MultiValue(double value) { *this = value; }
+		// Exact whenever both the mantissa and the power of ten are exactly representable, which covers nearly
+		// everything we parse; otherwise let the C library round correctly
+		if(!truncated && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+		{
+			double value = (double)mantissa;
+			value = exponent < 0 ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+			result = negative ? -value : value;
+		}
+		else
+		{
+			char buffer[512];
+			size_t length = std::min<size_t>(str - start, sizeof(buffer) - 1);
+			memcpy(buffer, start, length);
+			buffer[length] = 0;
 
-NaviUtilities::MultiValue::MultiValue(bool value) { *this = value; }
+			result = parseFloatingPoint(buffer);
+		}
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(const std::string &value)
-{
-	this->value = toWide(value);
-	isWide = false;
-	return *this;
+		return str - numberString;
+	}
 }
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(const std::wstring &value)
-{
-	this->value = value;
-	isWide = true;
-	return *this;
-}
+size_t NaviUtilities::formatNumber(int value, char* buffer) { return formatSigned<int, unsigned int>(value, buffer); }
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(int value)
-{
-	this->value = toWide(numberToString(value));
-	isWide = false;
-	return *this;
-}
+size_t NaviUtilities::formatNumber(unsigned int value, char* buffer) { return formatInteger(value, false, buffer); }
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(size_t value)
-{
-	this->value = toWide(numberToString(value));
-	isWide = false;
-	return *this;
-}
+size_t NaviUtilities::formatNumber(long value, char* buffer) { return formatSigned<long, unsigned long>(value, buffer); }
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(float value)
+size_t NaviUtilities::formatNumber(unsigned long value, char* buffer) { return formatInteger(value, false, buffer); }
+
+size_t NaviUtilities::formatNumber(long long value, char* buffer) { return formatSigned<long long, unsigned long long>(value, buffer); }
+
+size_t NaviUtilities::formatNumber(unsigned long long value, char* buffer) { return formatInteger(value, false, buffer); }
+
+size_t NaviUtilities::formatNumber(float value, char* buffer) { return formatRoundTrip(value, buffer); }
+
+size_t NaviUtilities::formatNumber(double value, char* buffer) { return formatRoundTrip(value, buffer); }
+
+size_t NaviUtilities::formatRoundTrip(float value, char* buffer) { return formatShortest(value, buffer, FLT_DIG, 9); }
+
+size_t NaviUtilities::formatRoundTrip(double value, char* buffer) { return formatShortest(value, buffer, DBL_DIG, 17); }
+
+size_t NaviUtilities::formatNumber(bool value, char* buffer)
 {
-	this->value = toWide(numberToString(value));
-	isWide = false;
-	return *this;
+	buffer[0] = value ? '1' : '0';
+	buffer[1] = 0;
+	return 1;
 }
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(double value)
+size_t NaviUtilities::parseNumber(const char* numberString, int& result) { return parseInteger<int, unsigned int>(numberString, result, true); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, unsigned int& result) { return parseInteger<unsigned int, unsigned int>(numberString, result, false); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, long& result) { return parseInteger<long, unsigned long>(numberString, result, true); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, unsigned long& result) { return parseInteger<unsigned long, unsigned long>(numberString, result, false); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, long long& result) { return parseInteger<long long, unsigned long long>(numberString, result, true); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, unsigned long long& result) { return parseInteger<unsigned long long, unsigned long long>(numberString, result, false); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, double& result) { return parseFloatingPoint(numberString, result); }
+
+size_t NaviUtilities::parseNumber(const char* numberString, float& result)
 {
-	this->value = toWide(numberToString(value));
-	isWide = false;
-	return *this;
+	double value;
+	size_t length = parseFloatingPoint(numberString, value);
+
+	if(length)
+		result = (float)value;
+
+	return length;
 }
 
-NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(bool value)
+size_t NaviUtilities::parseNumber(const char* numberString, bool& result)
 {
-	this->value = toWide(numberToString(value));
-	isWide = false;
-	return *this;
+	int value;
+	size_t length = parseNumber(numberString, value);
+
+	if(length)
+		result = value != 0;
+
+	return length;
 }
 
-std::wstring NaviUtilities::MultiValue::wstr() const { return value; }
+namespace
+{
+	const wchar_t replacementChar = 0xFFFD;
 
-std::string NaviUtilities::MultiValue::str() const {return toMultibyte(value); }
+	inline bool isContinuation(unsigned char c)
+	{
+		return (c & 0xC0) == 0x80;
+	}
 
-bool NaviUtilities::MultiValue::isEmpty() const { return value.empty(); }
+	/**
+	* Decodes one code point starting at 'src'. Returns the number of bytes consumed (always at least 1);
+	* malformed, overlong, surrogate and out-of-range sequences consume a single byte and set 'valid' to false.
+	*/
+	inline size_t decodeCodePoint(const unsigned char* src, size_t remaining, unsigned int& codePoint, bool& valid)
+	{
+		unsigned int c = src[0];
+		valid = true;
 
-bool NaviUtilities::MultiValue::isNumber() const { return isNumeric(toMultibyte(value)); }
+		if(c < 0x80)
+		{
+			codePoint = c;
+			return 1;
+		}
+		else if(c >= 0xC2 && c <= 0xDF)
+		{
+			if(remaining >= 2 && isContinuation(src[1]))
+			{
+				codePoint = ((c & 0x1F) << 6) | (src[1] & 0x3F);
+				return 2;
+			}
+		}
+		else if(c >= 0xE0 && c <= 0xEF)
+		{
+			if(remaining >= 3 && isContinuation(src[1]) && isContinuation(src[2]))
+			{
+				codePoint = ((c & 0x0F) << 12) | ((src[1] & 0x3F) << 6) | (src[2] & 0x3F);
 
-bool NaviUtilities::MultiValue::isWideString() const { return isWide; }
+				if(codePoint >= 0x800 && (codePoint < 0xD800 || codePoint > 0xDFFF))
+					return 3;
+			}
+		}
+		else if(c >= 0xF0 && c <= 0xF4)
+		{
+			if(remaining >= 4 && isContinuation(src[1]) && isContinuation(src[2]) && isContinuation(src[3]))
+			{
+				codePoint = ((c & 0x07) << 18) | ((src[1] & 0x3F) << 12) | ((src[2] & 0x3F) << 6) | (src[3] & 0x3F);
 
-int NaviUtilities::MultiValue::toInt() const { return toNumber<int>(toMultibyte(value)); }
+				if(codePoint >= 0x10000 && codePoint <= 0x10FFFF)
+					return 4;
+			}
+		}
 
-float NaviUtilities::MultiValue::toFloat() const { return toNumber<float>(toMultibyte(value)); }
+		codePoint = replacementChar;
+		valid = false;
+		return 1;
+	}
 
-double NaviUtilities::MultiValue::toDouble() const  { return toNumber<double>(toMultibyte(value)); }
+	/**
+	* Returns the length of the leading run of ASCII bytes, scanning 16 bytes at a time when SSE2 is available.
+	*/
+	inline size_t asciiPrefixLength(const unsigned char* src, size_t length)
+	{
+		size_t i = 0;
 
-bool NaviUtilities::MultiValue::toBool() const { return toNumber<bool>(toMultibyte(value)); }
+#if OGRE_CPU == OGRE_CPU_X86
+		if(hasSSE2())
+		{
+			for(; i + 16 <= length; i += 16)
+			{
+				int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + i)));
+
+				if(mask)
+				{
+					while(!(mask & 1))
+					{
+						mask >>= 1;
+						i++;
+					}
+
+					return i;
+				}
+			}
+		}
+#endif
 
-std::string NaviUtilities::templateString(const std::string &templateStr, const NaviUtilities::Args &args)
-{
-	if(!(args.size() && templateStr.size()))
-		return templateStr;
+		while(i < length && src[i] < 0x80)
+			i++;
 
-	std::string result;
-	std::vector<std::string> temp = split(templateStr, "?", false);
+		return i;
+	}
 
-	for(unsigned int i = 0; i < temp.size(); ++i)
+	/**
+	* Widens a run of ASCII bytes into 'dest'.
+	*/
+	inline void widenASCII(const unsigned char* src, size_t length, wchar_t* dest)
 	{
-		result += temp[i];
-		if(args.size() > i && i != temp.size()-1)
-			result += args[i].str();			
-	}
+		size_t i = 0;
 
-	return result;
-}
+#if OGRE_CPU == OGRE_CPU_X86
+		if(hasSSE2())
+		{
+			const __m128i zero = _mm_setzero_si128();
+
+			for(; i + 16 <= length; i += 16)
+			{
+				__m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i low = _mm_unpacklo_epi8(bytes, zero);
+				__m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+				if(sizeof(wchar_t) == 2)
+				{
+					_mm_storeu_si128((__m128i*)(dest + i), low);
+					_mm_storeu_si128((__m128i*)(dest + i + 8), high);
+				}
+				else
+				{
+					_mm_storeu_si128((__m128i*)(dest + i), _mm_unpacklo_epi16(low, zero));
+					_mm_storeu_si128((__m128i*)(dest + i + 4), _mm_unpackhi_epi16(low, zero));
+					_mm_storeu_si128((__m128i*)(dest + i + 8), _mm_unpacklo_epi16(high, zero));
+					_mm_storeu_si128((__m128i*)(dest + i + 12), _mm_unpackhi_epi16(high, zero));
+				}
+			}
+		}
+#endif
 
-void NaviUtilities::logTemplate(const std::string &templateStr, const NaviUtilities::Args &args)
-{
-	Ogre::LogManager::getSingleton().logMessage(templateString(templateStr, args));
-}
+		for(; i < length; i++)
+			dest[i] = src[i];
+	}
 
-bool NaviUtilities::hexStringToRGB(const std::string& hexString, unsigned char &R, unsigned char &G, unsigned char &B)
-{
-	if(hexString.length() == 7)
+	/**
+	* Narrows the leading run of ASCII wide characters into 'dest' (if non-null), returning its length.
+	*/
+	inline size_t narrowASCII(const wchar_t* src, size_t length, char* dest)
 	{
-		if(hexString.find("#") == 0 && hexString.substr(1).find_first_not_of("0123456789ABCDEFabcdef") == std::string::npos)
+		size_t i = 0;
+
+#if OGRE_CPU == OGRE_CPU_X86
+		if(hasSSE2() && sizeof(wchar_t) == 2)
 		{
-			R = static_cast<unsigned char>(strtoul(hexString.substr(1, 2).c_str(), 0, 16));
-			G = static_cast<unsigned char>(strtoul(hexString.substr(3, 2).c_str(), 0, 16));
-			B = static_cast<unsigned char>(strtoul(hexString.substr(5, 2).c_str(), 0, 16));
+			const __m128i highBits = _mm_set1_epi16((short)0xFF80);
 
-			return true;
+			for(; i + 16 <= length; i += 16)
+			{
+				__m128i low = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i high = _mm_loadu_si128((const __m128i*)(src + i + 8));
+
+				if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(low, high), highBits), _mm_setzero_si128())) != 0xFFFF)
+					break;
+
+				if(dest)
+					_mm_storeu_si128((__m128i*)(dest + i), _mm_packus_epi16(low, high));
+			}
+		}
+		else if(hasSSE2())
+		{
+			const __m128i highBits = _mm_set1_epi32((int)0xFFFFFF80);
+
+			for(; i + 16 <= length; i += 16)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+				__m128i c = _mm_loadu_si128((const __m128i*)(src + i + 8));
+				__m128i d = _mm_loadu_si128((const __m128i*)(src + i + 12));
+				__m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+
+				if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, highBits), _mm_setzero_si128())) != 0xFFFF)
+					break;
+
+				if(dest)
+					_mm_storeu_si128((__m128i*)(dest + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+			}
 		}
+#endif
+
+		for(; i < length && (unsigned int)src[i] < 0x80; i++)
+			if(dest)
+				dest[i] = (char)src[i];
+
+		return i;
 	}
 
-	return false;
-}
+	/**
+	* Encodes a wide string as UTF-8 into 'dest' (if non-null), returning the number of bytes required.
+	* Wide strings are treated as UTF-16 when wchar_t is 16 bits wide and as UTF-32 otherwise; unpaired
+	* surrogates and out-of-range values are encoded as U+FFFD.
+	*/
+	size_t encodeUTF8(const wchar_t* src, size_t length, char* dest)
+	{
+		size_t i = 0;
+		size_t count = 0;
 
-/**
-* The following is freely-available code by Ren Nyffenegger
-* Obtained from: http://www.adp-gmbh.ch/cpp/common/base64.html
-*/
-std::string NaviUtilities::encodeBase64(const std::string &strToEncode)
-{
-	unsigned char const* bytes_to_encode = reinterpret_cast<const unsigned char*>(strToEncode.c_str());
-	unsigned int in_len = (unsigned int)strToEncode.length();
-	const std::string base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		while(i < length)
+		{
+			// Only look for a run of ASCII where one starts, text in other scripts rarely has long runs
+			if((unsigned int)src[i] < 0x80)
+			{
+				size_t run = narrowASCII(src + i, length - i, dest ? dest + count : 0);
+				i += run;
+				count += run;
+				continue;
+			}
+
+			unsigned int codePoint = (unsigned int)src[i++];
+
+			if(sizeof(wchar_t) == 2 && codePoint >= 0xD800 && codePoint <= 0xDBFF && i < length &&
+				(unsigned int)src[i] >= 0xDC00 && (unsigned int)src[i] <= 0xDFFF)
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + ((unsigned int)src[i++] - 0xDC00);
+			else if((codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF)
+				codePoint = replacementChar;
+
+			if(codePoint < 0x800)
+			{
+				if(dest)
+				{
+					dest[count] = (char)(0xC0 | (codePoint >> 6));
+					dest[count + 1] = (char)(0x80 | (codePoint & 0x3F));
+				}
+
+				count += 2;
+			}
+			else if(codePoint < 0x10000)
+			{
+				if(dest)
+				{
+					dest[count] = (char)(0xE0 | (codePoint >> 12));
+					dest[count + 1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+					dest[count + 2] = (char)(0x80 | (codePoint & 0x3F));
+				}
+
+				count += 3;
+			}
+			else
+			{
+				if(dest)
+				{
+					dest[count] = (char)(0xF0 | (codePoint >> 18));
+					dest[count + 1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+					dest[count + 2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+					dest[count + 3] = (char)(0x80 | (codePoint & 0x3F));
+				}
+
+				count += 4;
+			}
+		}
 
-	std::string ret;
-	int i = 0;
-	int j = 0;
-	unsigned char char_array_3[3];
-	unsigned char char_array_4[4];
+		return count;
+	}
 
-	while(in_len--)
+	/**
+	* Encodes in blocks, each into room for its worst case, so that the source is only read once and the string
+	* never holds more than a block's worth of unused space.
+	*/
+	void appendMultibyte(std::string& dest, const std::wstring& source)
 	{
-		char_array_3[i++] = *(bytes_to_encode++);
+		const size_t blockLength = 4096;
+		const size_t maxBytesPerUnit = sizeof(wchar_t) == 2 ? 3 : 4;
 
-		if(i == 3)
+		dest.reserve(dest.size() + source.size() + std::min(source.size(), blockLength) * (maxBytesPerUnit - 1));
+
+		for(size_t i = 0; i < source.size();)
 		{
-			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-			char_array_4[3] = char_array_3[2] & 0x3f;
+			size_t length = std::min(blockLength, source.size() - i);
 
-			for(i = 0; i < 4; i++)
-				ret += base64_chars[char_array_4[i]];
+			// Keep surrogate pairs within a block
+			if(sizeof(wchar_t) == 2 && i + length < source.size() && (unsigned int)source[i + length - 1] >= 0xD800 &&
+				(unsigned int)source[i + length - 1] <= 0xDBFF)
+				length--;
 
-			i = 0;
+			size_t offset = dest.size();
+			dest.resize(offset + length * maxBytesPerUnit);
+			dest.resize(offset + encodeUTF8(source.data() + i, length, &dest[offset]));
+			i += length;
 		}
 	}
+}
+
+size_t NaviUtilities::toWide(const char* source, size_t length, wchar_t* dest)
+{
+	const unsigned char* src = reinterpret_cast<const unsigned char*>(source);
+	size_t i = 0;
+	size_t count = 0;
 
-	if(i)
+	while(i < length)
 	{
-		for(j = i; j < 3; j++)
-			char_array_3[j] = '\0';
+		if(src[i] < 0x80)
+		{
+			size_t run = asciiPrefixLength(src + i, length - i);
+
+			if(dest)
+				widenASCII(src + i, run, dest + count);
+
+			i += run;
+			count += run;
+			continue;
+		}
 
-		char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-		char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-		char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-		char_array_4[3] = char_array_3[2] & 0x3f;
+		unsigned int codePoint;
+		bool valid;
+		i += decodeCodePoint(src + i, length - i, codePoint, valid);
 
-		for (j = 0; (j < i + 1); j++)
-			ret += base64_chars[char_array_4[j]];
+		if(sizeof(wchar_t) == 2 && codePoint >= 0x10000)
+		{
+			if(dest)
+			{
+				dest[count] = (wchar_t)(0xD800 + ((codePoint - 0x10000) >> 10));
+				dest[count + 1] = (wchar_t)(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+			}
+
+			count += 2;
+		}
+		else
+		{
+			if(dest)
+				dest[count] = (wchar_t)codePoint;
 
-		while((i++ < 3))
-			ret += '=';
+			count++;
+		}
 	}
 
-	return ret;
+	return count;
+}
+
+void NaviUtilities::toWide(const std::string &stringToConvert, std::wstring &result)
+{
+	// A UTF-8 sequence never decodes to more UTF-16/UTF-32 units than it has bytes
+	result.resize(stringToConvert.size());
+
+	if(!stringToConvert.empty())
+		result.resize(toWide(stringToConvert.data(), stringToConvert.size(), &result[0]));
+}
+
+std::wstring NaviUtilities::toWide(const std::string &stringToConvert)
+{
+	std::wstring result;
+	toWide(stringToConvert, result);
+	return result;
+}
+
+size_t NaviUtilities::toMultibyte(const wchar_t* source, size_t length, char* dest)
+{
+	return encodeUTF8(source, length, dest);
+}
+
+void NaviUtilities::toMultibyte(const std::wstring &wstringToConvert, std::string &result)
+{
+	result.clear();
+	appendMultibyte(result, wstringToConvert);
+}
+
+std::string NaviUtilities::toMultibyte(const std::wstring &wstringToConvert)
+{
+	std::string result;
+	appendMultibyte(result, wstringToConvert);
+	return result;
+}
+
+bool NaviUtilities::isValidUTF8(const char* source, size_t length)
+{
+	const unsigned char* src = reinterpret_cast<const unsigned char*>(source);
+	size_t i = 0;
+
+	while(i < length)
+	{
+		if(src[i] < 0x80)
+		{
+			i += asciiPrefixLength(src + i, length - i);
+			continue;
+		}
+
+		unsigned int codePoint;
+		bool valid;
+		i += decodeCodePoint(src + i, length - i, codePoint, valid);
+
+		if(!valid)
+			return false;
+	}
+
+	return true;
+}
+
+bool NaviUtilities::isValidUTF8(const std::string &source)
+{
+	return isValidUTF8(source.data(), source.size());
+}
+
+void NaviUtilities::setLocale(const std::string &localeLanguage)
+{
+	setlocale(LC_CTYPE, localeLanguage.c_str());
+}
+
+int NaviUtilities::replaceAll(std::string &sourceStr, const std::string &replaceWhat, const std::string &replaceWith)
+{
+	if(replaceWhat.empty())
+		return 0;
+
+	size_t i = sourceStr.find(replaceWhat);
+	if(i == std::string::npos)
+		return 0;
+
+	// Build the result in one pass rather than shifting the tail of the string for every match
+	std::string result;
+	result.reserve(sourceStr.length() + (replaceWith.length() > replaceWhat.length() ? sourceStr.length() / 8 : 0));
+
+	int count = 0;
+	size_t last = 0;
+
+	for(; i != std::string::npos; i = sourceStr.find(replaceWhat, last))
+	{
+		result.append(sourceStr, last, i - last);
+		result += replaceWith;
+		last = i + replaceWhat.length();
+		++count;
+	}
+
+	result.append(sourceStr, last, std::string::npos);
+	sourceStr.swap(result);
+
+	return count;
+}
+
+NaviUtilities::Replacer::Replacer() { }
+
+NaviUtilities::Replacer::Replacer(const std::string &replaceWhat, const std::string &replaceWith)
+{
+	(*this)(replaceWhat, replaceWith);
+}
+
+NaviUtilities::Replacer& NaviUtilities::Replacer::operator()(const std::string &replaceWhat, const std::string &replaceWith)
+{
+	if(replaceWhat.empty())
+		return *this;
+
+	patterns.push_back(std::make_pair(replaceWhat, replaceWith));
+
+	// Keep the candidates for each first character ordered longest first
+	std::vector<unsigned short>& list = candidates[(unsigned char)replaceWhat[0]];
+	std::vector<unsigned short>::iterator pos = list.begin();
+	while(pos != list.end() && patterns[*pos].first.length() >= replaceWhat.length())
+		++pos;
+
+	list.insert(pos, (unsigned short)(patterns.size() - 1));
+
+	return *this;
+}
+
+int NaviUtilities::Replacer::replaceAll(std::string &sourceStr) const
+{
+	const char* src = sourceStr.data();
+	size_t length = sourceStr.length();
+
+	std::string result;
+	int count = 0;
+	size_t last = 0;
+
+	for(size_t i = 0; i < length; )
+	{
+		const std::vector<unsigned short>& list = candidates[(unsigned char)src[i]];
+		const std::pair<std::string, std::string>* match = 0;
+
+		for(std::vector<unsigned short>::const_iterator c = list.begin(); c != list.end(); ++c)
+		{
+			const std::string& pattern = patterns[*c].first;
+
+			if(pattern.length() <= length - i && !memcmp(src + i, pattern.data(), pattern.length()))
+			{
+				match = &patterns[*c];
+				break;
+			}
+		}
+
+		if(!match)
+		{
+			i++;
+			continue;
+		}
+
+		if(!count)
+			result.reserve(length + length / 8);
+
+		result.append(src + last, i - last);
+		result += match->second;
+		i += match->first.length();
+		last = i;
+		++count;
+	}
+
+	if(count)
+	{
+		result.append(src + last, length - last);
+		sourceStr.swap(result);
+	}
+
+	return count;
+}
+
+NaviUtilities::StringRef NaviUtilities::StringRef::substr(size_t offset, size_t count) const
+{
+	offset = std::min(offset, length);
+
+	return StringRef(chars + offset, std::min(count, length - offset));
+}
+
+size_t NaviUtilities::StringRef::find(const StringRef& what, size_t offset) const
+{
+	if(offset > length || what.length > length - offset)
+		return std::string::npos;
+
+	if(what.length == 1)
+	{
+		const void* match = memchr(chars + offset, what.chars[0], length - offset);
+		return match ? (const char*)match - chars : std::string::npos;
+	}
+
+	const char* end = chars + length;
+	const char* match = std::search(chars + offset, end, what.chars, what.chars + what.length);
+
+	return match == end && what.length ? std::string::npos : match - chars;
+}
+
+NaviUtilities::Splitter::Splitter(const StringRef& source, const StringRef& delimiter, bool ignoreEmpty)
+	: source(source), delimiter(delimiter), position(0), ignoreEmpty(ignoreEmpty), done(false)
+{
+}
+
+bool NaviUtilities::Splitter::next(StringRef& token)
+{
+	while(!done)
+	{
+		size_t end = delimiter.empty() ? std::string::npos : source.find(delimiter, position);
+
+		if(end == std::string::npos)
+		{
+			token = source.substr(position);
+			done = true;
+		}
+		else
+		{
+			token = source.substr(position, end - position);
+			position = end + delimiter.size();
+		}
+
+		if(!(ignoreEmpty && token.empty()))
+			return true;
+	}
+
+	return false;
+}
+
+size_t NaviUtilities::splitToPairs(const StringRef& source, const StringRef& pairDelimiter, const StringRef& keyValueDelimiter, 
+								   std::vector<std::pair<StringRef, StringRef> >& pairs, bool ignoreEmpty)
+{
+	pairs.clear();
+
+	Splitter splitter(source, pairDelimiter);
+	StringRef token;
+
+	while(splitter.next(token))
+	{
+		size_t idx = token.find(keyValueDelimiter);
+		if(idx == std::string::npos)
+			continue;
+
+		StringRef key = token.substr(0, idx);
+		StringRef value = token.substr(idx + keyValueDelimiter.size());
+
+		if(!(ignoreEmpty && (key.empty() || value.empty())))
+			pairs.push_back(std::make_pair(key, value));
+	}
+
+	return pairs.size();
+}
+
+std::vector<std::string> NaviUtilities::split(const std::string &sourceStr, const std::string &delimiter, bool ignoreEmpty)
+{
+	std::vector<std::string> resultVector;
+
+	Splitter splitter(sourceStr, delimiter, ignoreEmpty);
+	StringRef token;
+
+	while(splitter.next(token))
+		resultVector.push_back(token.str());
+
+	return resultVector;
+}
+
+std::map<std::string,std::string> NaviUtilities::splitToMap(const std::string &sourceStr, const std::string &pairDelimiter, const std::string &keyValueDelimiter, bool ignoreEmpty)
+{
+	std::map<std::string,std::string> resultMap;
+	std::vector<std::pair<StringRef, StringRef> > pairs;
+
+	splitToPairs(sourceStr, pairDelimiter, keyValueDelimiter, pairs, ignoreEmpty);
+
+	// The first occurrence of a key wins
+	for(std::vector<std::pair<StringRef, StringRef> >::const_iterator i = pairs.begin(); i != pairs.end(); i++)
+		resultMap.insert(std::make_pair(i->first.str(), i->second.str()));
+
+	return resultMap;
+}
+
+std::string NaviUtilities::join(const std::vector<std::string> &sourceVector, const std::string &delimiter, bool ignoreEmpty)
+{
+	// Measure first so that the result is allocated once
+	size_t length = 0;
+
+	for(std::vector<std::string>::const_iterator i = sourceVector.begin(); i != sourceVector.end(); i++)
+		if(!(ignoreEmpty && i->empty()))
+			length += length ? delimiter.length() + i->length() : i->length();
+
+	std::string result;
+	result.reserve(length);
+
+	for(std::vector<std::string>::const_iterator i = sourceVector.begin(); i != sourceVector.end(); i++)
+	{
+		if(!(ignoreEmpty && i->empty()))
+		{
+			if(result.length())
+				result += delimiter;
+
+			result += *i;
+		}
+	}
+
+	return result;
+}
+
+std::string NaviUtilities::joinFromMap(const std::map<std::string,std::string> &sourceMap, const std::string &pairDelimiter, const std::string &keyValueDelimiter, bool ignoreEmpty)
+{
+	size_t length = 0;
+
+	for(std::map<std::string,std::string>::const_iterator i = sourceMap.begin(); i != sourceMap.end(); i++)
+		if(!(ignoreEmpty && (i->first.empty() || i->second.empty())))
+			length += (length ? pairDelimiter.length() : 0) + i->first.length() + keyValueDelimiter.length() + i->second.length();
+
+	std::string result;
+	result.reserve(length);
+
+	for(std::map<std::string,std::string>::const_iterator i = sourceMap.begin(); i != sourceMap.end(); i++)
+	{
+		if(!(ignoreEmpty && (i->first.empty() || i->second.empty())))
+		{
+			if(result.length())
+				result += pairDelimiter;
+
+			result += i->first;
+			result += keyValueDelimiter;
+			result += i->second;
+		}
+	}
+
+	return result;
+}
+
+namespace
+{
+	template<class Type>
+	void destroy(Type& object)
+	{
+		object.~Type();
+	}
+}
+
+NaviUtilities::MultiValue::MultiValue() : type(TypeEmpty) { }
+
+NaviUtilities::MultiValue::MultiValue(const MultiValue &original) : type(TypeEmpty) { *this = original; }
+
+NaviUtilities::MultiValue::MultiValue(const std::string &value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::MultiValue(const char *value) : type(TypeEmpty) { *this = std::string(value); }
+
+NaviUtilities::MultiValue::MultiValue(const std::wstring &value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::MultiValue(int value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::MultiValue(size_t value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::MultiValue(float value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::MultiValue(double value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::MultiValue(bool value) : type(TypeEmpty) { *this = value; }
+
+NaviUtilities::MultiValue::~MultiValue()
+{
+	release();
+}
+
+void NaviUtilities::MultiValue::release()
+{
+	if(type == TypeString)
+		destroy(narrowValue());
+	else if(type == TypeWideString)
+		destroy(wideValue());
+
+	type = TypeEmpty;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(const MultiValue &value)
+{
+	switch(value.type)
+	{
+	case TypeString: return *this = value.narrowValue();
+	case TypeWideString: return *this = value.wideValue();
+	default:
+		release();
+		memcpy(&data, &value.data, sizeof(data));
+		type = value.type;
+		return *this;
+	}
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(const std::string &value)
+{
+	if(type == TypeString)
+		narrowValue() = value;
+	else
+	{
+		release();
+		new(data.narrowStorage) std::string(value);
+		type = TypeString;
+	}
+
+	return *this;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(const std::wstring &value)
+{
+	if(type == TypeWideString)
+		wideValue() = value;
+	else
+	{
+		release();
+		new(data.wideStorage) std::wstring(value);
+		type = TypeWideString;
+	}
+
+	return *this;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(int value)
+{
+	release();
+	data.intValue = value;
+	type = TypeInt;
+	return *this;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(size_t value)
+{
+	release();
+	data.sizeValue = value;
+	type = TypeSizeT;
+	return *this;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(float value)
+{
+	release();
+	data.floatValue = value;
+	type = TypeFloat;
+	return *this;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(double value)
+{
+	release();
+	data.doubleValue = value;
+	type = TypeDouble;
+	return *this;
+}
+
+NaviUtilities::MultiValue& NaviUtilities::MultiValue::operator=(bool value)
+{
+	release();
+	data.boolValue = value;
+	type = TypeBool;
+	return *this;
+}
+
+std::wstring NaviUtilities::MultiValue::wstr() const
+{
+	return type == TypeWideString ? wideValue() : toWide(str());
+}
+
+std::string NaviUtilities::MultiValue::str() const
+{
+	switch(type)
+	{
+	case TypeString: return narrowValue();
+	case TypeWideString: return toMultibyte(wideValue());
+	case TypeInt: return numberToString(data.intValue);
+	case TypeSizeT: return numberToString(data.sizeValue);
+	case TypeFloat: return numberToString(data.floatValue);
+	case TypeDouble: return numberToString(data.doubleValue);
+	case TypeBool: return data.boolValue ? "1" : "0";
+	default: return "";
+	}
+}
+
+void NaviUtilities::MultiValue::appendTo(std::string &dest) const
+{
+	char buffer[NumberBufferSize];
+
+	switch(type)
+	{
+	case TypeString: dest += narrowValue(); break;
+	case TypeWideString: appendMultibyte(dest, wideValue()); break;
+	case TypeInt: dest.append(buffer, formatNumber(data.intValue, buffer)); break;
+	case TypeSizeT: dest.append(buffer, formatNumber(data.sizeValue, buffer)); break;
+	case TypeFloat: dest.append(buffer, formatNumber(data.floatValue, buffer)); break;
+	case TypeDouble: dest.append(buffer, formatNumber(data.doubleValue, buffer)); break;
+	case TypeBool: dest += data.boolValue ? '1' : '0'; break;
+	default: break;
+	}
+}
+
+bool NaviUtilities::MultiValue::isEmpty() const
+{
+	return type == TypeEmpty || (type == TypeString && narrowValue().empty()) || (type == TypeWideString && wideValue().empty());
+}
+
+bool NaviUtilities::MultiValue::isNumber() const
+{
+	switch(type)
+	{
+	case TypeEmpty: return false;
+	case TypeString: return isNumeric(narrowValue());
+	case TypeWideString: return isNumeric(toMultibyte(wideValue()));
+	default: return true;
+	}
+}
+
+bool NaviUtilities::MultiValue::isWideString() const { return type == TypeWideString; }
+
+int NaviUtilities::MultiValue::toInt() const { return toNumberType<int>(); }
+
+float NaviUtilities::MultiValue::toFloat() const { return toNumberType<float>(); }
+
+double NaviUtilities::MultiValue::toDouble() const  { return toNumberType<double>(); }
+
+bool NaviUtilities::MultiValue::toBool() const
+{
+	if(type == TypeString || type == TypeWideString)
+		return toNumberType<bool>();
+
+	return toNumberType<int>() != 0;
+}
+
+namespace
+{
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	inline long atomicIncrement(volatile long* value) { return InterlockedIncrement(value); }
+
+	inline long atomicDecrement(volatile long* value) { return InterlockedDecrement(value); }
+
+	inline long atomicExchange(volatile long* target, long value) { return InterlockedExchange(target, value); }
+
+	inline void* atomicExchangePointer(void* volatile* target, void* value) { return InterlockedExchangePointer(target, value); }
+
+	inline void yieldThread() { Sleep(0); }
+
+	class Mutex
+	{
+		CRITICAL_SECTION section;
+
+		Mutex(const Mutex&);
+		Mutex& operator=(const Mutex&);
+
+	public:
+		Mutex() { InitializeCriticalSection(&section); }
+		~Mutex() { DeleteCriticalSection(&section); }
+
+		void lock() { EnterCriticalSection(&section); }
+		void unlock() { LeaveCriticalSection(&section); }
+	};
+#else
+	// The __sync builtins of GCC are full barriers, like the Interlocked functions
+	inline long atomicIncrement(volatile long* value) { return __sync_add_and_fetch(value, 1); }
+
+	inline long atomicDecrement(volatile long* value) { return __sync_sub_and_fetch(value, 1); }
+
+	inline long atomicExchange(volatile long* target, long value)
+	{
+		long previous;
+		do
+			previous = *target;
+		while(__sync_val_compare_and_swap(target, previous, value) != previous);
+
+		return previous;
+	}
+
+	inline void* atomicExchangePointer(void* volatile* target, void* value)
+	{
+		void* previous;
+		do
+			previous = *target;
+		while(__sync_val_compare_and_swap(target, previous, value) != previous);
+
+		return previous;
+	}
+
+	inline void yieldThread() { sched_yield(); }
+
+	class Mutex
+	{
+		pthread_mutex_t mutex;
+
+		Mutex(const Mutex&);
+		Mutex& operator=(const Mutex&);
+
+	public:
+		Mutex() { pthread_mutex_init(&mutex, 0); }
+		~Mutex() { pthread_mutex_destroy(&mutex); }
+
+		void lock() { pthread_mutex_lock(&mutex); }
+		void unlock() { pthread_mutex_unlock(&mutex); }
+	};
+#endif
+
+	struct LogEntry
+	{
+		LogEntry* volatile next;
+		std::string message;
+	};
+
+	/**
+	* An intrusive multiple-producer, single-consumer queue (after Dmitry Vyukov): producers only swap the head,
+	* the single consumer owns the tail.
+	*/
+	class LogQueue
+	{
+		LogEntry stub;
+		LogEntry* volatile head;
+		LogEntry* tail;
+
+	public:
+		LogQueue() : head(&stub), tail(&stub) { stub.next = 0; }
+
+		void push(LogEntry* entry)
+		{
+			entry->next = 0;
+			LogEntry* previous = (LogEntry*)atomicExchangePointer((void* volatile*)&head, entry);
+			previous->next = entry;
+		}
+
+		LogEntry* pop()
+		{
+			LogEntry* first = tail;
+			LogEntry* next = first->next;
+
+			if(first == &stub)
+			{
+				if(!next)
+					return 0;
+
+				tail = next;
+				first = next;
+				next = next->next;
+			}
+
+			if(next)
+			{
+				tail = next;
+				return first;
+			}
+
+			// A producer is in the middle of a push, we'll get the entry next time
+			if(first != head)
+				return 0;
+
+			push(&stub);
+			next = first->next;
+
+			if(next)
+			{
+				tail = next;
+				return first;
+			}
+
+			return 0;
+		}
+	};
+
+	struct ParsedTemplate
+	{
+		std::string text;
+		std::vector<NaviUtilities::StringRef> segments;
+		volatile long references;
+		std::list<ParsedTemplate*>::iterator lruPosition;
+	};
+
+	struct TemplateKeyLess
+	{
+		bool operator()(const NaviUtilities::StringRef& a, const NaviUtilities::StringRef& b) const
+		{
+			int order = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+			return order ? order < 0 : a.size() < b.size();
+		}
+	};
+
+	/**
+	* Parsed templates shared by templateString and logTemplate, keyed by content and bounded in size (the
+	* least-recently-used template is dropped). The lock is only held to look a template up; entries are
+	* reference-counted so that they can be used for formatting after it has been released.
+	*/
+	class TemplateCache
+	{
+		typedef std::map<NaviUtilities::StringRef, ParsedTemplate*, TemplateKeyLess> EntryMap;
+
+		Mutex mutex;
+		EntryMap entries;
+		std::list<ParsedTemplate*> lru;
+
+	public:
+		static const size_t MaxEntries = 256;
+
+		~TemplateCache()
+		{
+			for(EntryMap::iterator i = entries.begin(); i != entries.end(); ++i)
+				release(i->second);
+		}
+
+		const ParsedTemplate* acquire(const NaviUtilities::StringRef& templateStr)
+		{
+			mutex.lock();
+
+			ParsedTemplate* parsed;
+			EntryMap::iterator found = entries.find(templateStr);
+
+			if(found != entries.end())
+			{
+				parsed = found->second;
+				lru.splice(lru.begin(), lru, parsed->lruPosition);
+			}
+			else
+			{
+				if(entries.size() >= MaxEntries)
+				{
+					ParsedTemplate* oldest = lru.back();
+					lru.pop_back();
+					entries.erase(NaviUtilities::StringRef(oldest->text));
+					release(oldest);
+				}
+
+				// The cache holds one reference of its own
+				parsed = new ParsedTemplate;
+				parsed->references = 1;
+				parsed->text.assign(templateStr.data(), templateStr.size());
+
+				NaviUtilities::Splitter splitter(parsed->text, "?", false);
+				NaviUtilities::StringRef segment;
+				while(splitter.next(segment))
+					parsed->segments.push_back(segment);
+
+				lru.push_front(parsed);
+				parsed->lruPosition = lru.begin();
+				entries.insert(std::make_pair(NaviUtilities::StringRef(parsed->text), parsed));
+			}
+
+			atomicIncrement(&parsed->references);
+
+			mutex.unlock();
+
+			return parsed;
+		}
+
+		static void release(const ParsedTemplate* parsed)
+		{
+			ParsedTemplate* entry = const_cast<ParsedTemplate*>(parsed);
+
+			if(!atomicDecrement(&entry->references))
+				delete entry;
+		}
+	} templateCache;
+
+	/**
+	* Holds a reference to a parsed template for as long as it is in scope.
+	*/
+	class TemplateHandle
+	{
+		const ParsedTemplate* parsed;
+
+		TemplateHandle(const TemplateHandle&);
+		TemplateHandle& operator=(const TemplateHandle&);
+
+	public:
+		TemplateHandle(const NaviUtilities::StringRef& templateStr) : parsed(templateCache.acquire(templateStr)) { }
+		~TemplateHandle() { TemplateCache::release(parsed); }
+
+		const ParsedTemplate* operator->() const { return parsed; }
+	};
+
+	struct AsyncLog
+	{
+		LogQueue queue;
+		volatile long enabled;
+		volatile long publishing;
+		volatile long queued;
+		volatile long written;
+		volatile long dropped;
+		long maxQueued;
+		long reportedDropped;
+#ifdef NAVI_LOG_WRITER_THREAD
+		HANDLE thread;
+		HANDLE wakeEvent;
+		volatile long running;
+#endif
+
+		AsyncLog() : enabled(0), publishing(0), queued(0), written(0), dropped(0), maxQueued(4096), reportedDropped(0)
+#ifdef NAVI_LOG_WRITER_THREAD
+			, thread(0), wakeEvent(0), running(0)
+#endif
+		{ }
+
+		bool hasWriterThread() const
+		{
+#ifdef NAVI_LOG_WRITER_THREAD
+			return thread != 0;
+#else
+			return false;
+#endif
+		}
+
+		void wakeWriterThread()
+		{
+#ifdef NAVI_LOG_WRITER_THREAD
+			if(thread)
+				SetEvent(wakeEvent);
+#endif
+		}
+	} asyncLog;
+
+	void drainLog()
+	{
+		Ogre::LogManager& logManager = Ogre::LogManager::getSingleton();
+
+		while(LogEntry* entry = asyncLog.queue.pop())
+		{
+			logManager.logMessage(entry->message);
+			delete entry;
+
+			atomicDecrement(&asyncLog.queued);
+			atomicIncrement(&asyncLog.written);
+		}
+
+		long dropped = asyncLog.dropped;
+		if(dropped != asyncLog.reportedDropped)
+		{
+			logManager.logMessage("NaviUtilities: " + NaviUtilities::numberToString(dropped - asyncLog.reportedDropped) + 
+				" log messages were dropped, the asynchronous log queue was full.");
+			asyncLog.reportedDropped = dropped;
+		}
+	}
+
+#ifdef NAVI_LOG_WRITER_THREAD
+	DWORD WINAPI logWriterThread(void*)
+	{
+		while(asyncLog.running)
+		{
+			// Wake up when messages arrive but write at most ten batches per second
+			WaitForSingleObject(asyncLog.wakeEvent, INFINITE);
+			drainLog();
+			Sleep(100);
+		}
+
+		return 0;
+	}
+#endif
+
+	/**
+	* Queues a message if asynchronous logging is enabled (dropping it if the queue is full) and returns
+	* whether it did; otherwise the caller writes the message itself. Producers are counted for as long as
+	* they may publish to the queue, so that setAsyncLogging(false) can wait for them before its last drain.
+	*/
+	bool queueLogMessage(std::string& message)
+	{
+		atomicIncrement(&asyncLog.publishing);
+
+		bool enabled = asyncLog.enabled != 0;
+
+		if(enabled)
+		{
+			if(atomicIncrement(&asyncLog.queued) > asyncLog.maxQueued)
+			{
+				atomicDecrement(&asyncLog.queued);
+				atomicIncrement(&asyncLog.dropped);
+			}
+			else
+			{
+				LogEntry* entry = new LogEntry;
+				entry->message.swap(message);
+				asyncLog.queue.push(entry);
+				asyncLog.wakeWriterThread();
+			}
+		}
+
+		atomicDecrement(&asyncLog.publishing);
+
+		return enabled;
+	}
+
+	void formatTemplate(const std::vector<NaviUtilities::StringRef>& segments, const NaviUtilities::Args &args, std::string& result)
+	{
+		for(size_t i = 0; i < segments.size(); ++i)
+		{
+			result.append(segments[i].data(), segments[i].size());
+			if(args.size() > i && i != segments.size() - 1)
+				args[i].appendTo(result);
+		}
+	}
+}
+
+std::string NaviUtilities::templateString(const std::string &templateStr, const NaviUtilities::Args &args)
+{
+	if(!(args.size() && templateStr.size()))
+		return templateStr;
+
+	std::string result;
+	result.reserve(templateStr.length() + args.size() * 8);
+
+	TemplateHandle parsed(templateStr);
+	formatTemplate(parsed->segments, args, result);
+
+	return result;
+}
+
+void NaviUtilities::logTemplate(const std::string &templateStr, const NaviUtilities::Args &args)
+{
+	std::string message = templateString(templateStr, args);
+
+	if(!queueLogMessage(message))
+		Ogre::LogManager::getSingleton().logMessage(message);
+}
+
+void NaviUtilities::logTemplate(const char* templateStr, const NaviUtilities::Args &args)
+{
+	std::string message;
+
+	if(args.empty())
+		message = templateStr;
+	else
+	{
+		TemplateHandle parsed(templateStr);
+		formatTemplate(parsed->segments, args, message);
+	}
+
+	if(!queueLogMessage(message))
+		Ogre::LogManager::getSingleton().logMessage(message);
+}
+
+void NaviUtilities::setAsyncLogging(bool enabled, size_t maxQueuedMessages)
+{
+	asyncLog.maxQueued = (long)maxQueuedMessages;
+
+	if(enabled == (asyncLog.enabled != 0))
+		return;
+
+	if(enabled)
+	{
+		atomicExchange(&asyncLog.enabled, 1);
+
+#ifdef NAVI_LOG_WRITER_THREAD
+		asyncLog.running = 1;
+		asyncLog.wakeEvent = CreateEvent(0, FALSE, FALSE, 0);
+		asyncLog.thread = CreateThread(0, 0, logWriterThread, 0, 0, 0);
+#endif
+	}
+	else
+	{
+		atomicExchange(&asyncLog.enabled, 0);
+
+		// Producers that saw logging still enabled may be about to push, wait for them
+		while(asyncLog.publishing)
+			yieldThread();
+
+#ifdef NAVI_LOG_WRITER_THREAD
+		if(asyncLog.thread)
+		{
+			asyncLog.running = 0;
+			SetEvent(asyncLog.wakeEvent);
+			WaitForSingleObject(asyncLog.thread, INFINITE);
+
+			CloseHandle(asyncLog.thread);
+			CloseHandle(asyncLog.wakeEvent);
+			asyncLog.thread = 0;
+			asyncLog.wakeEvent = 0;
+		}
+#endif
+
+		drainLog();
+	}
+}
+
+void NaviUtilities::flushLog()
+{
+	if(asyncLog.hasWriterThread())
+		asyncLog.wakeWriterThread();
+	else if(asyncLog.queued || asyncLog.dropped != asyncLog.reportedDropped)
+		drainLog();
+}
+
+void NaviUtilities::getLogStats(size_t& written, size_t& dropped, size_t& queued)
+{
+	written = asyncLog.written;
+	dropped = asyncLog.dropped;
+	queued = asyncLog.queued;
+}
+
+NaviUtilities::StringTemplate::StringTemplate(const std::string& templateStr) : text(templateStr)
+{
+	Splitter splitter(text, "?", false);
+	StringRef segment;
+	while(splitter.next(segment))
+		segments.push_back(segment);
+}
+
+NaviUtilities::StringTemplate::Formatter NaviUtilities::StringTemplate::format(std::string& output) const
+{
+	output.clear();
+
+	return Formatter(*this, output);
+}
+
+std::string NaviUtilities::StringTemplate::operator()(const Args& args) const
+{
+	if(args.empty())
+		return text;
+
+	std::string result;
+	formatTemplate(segments, args, result);
+
+	return result;
+}
+
+NaviUtilities::StringTemplate::Formatter::Formatter(const StringTemplate& owner, std::string& output) 
+	: owner(&owner), output(&output), nextSegment(1), active(true)
+{
+	output.append(owner.segments[0].data(), owner.segments[0].size());
+}
+
+NaviUtilities::StringTemplate::Formatter::Formatter(const Formatter& other) 
+	: owner(other.owner), output(other.output), nextSegment(other.nextSegment), active(other.active)
+{
+	// Only one copy finishes the output
+	other.active = false;
+}
+
+NaviUtilities::StringTemplate::Formatter::~Formatter()
+{
+	if(!active)
+		return;
+
+	for(; nextSegment < owner->segments.size(); nextSegment++)
+		output->append(owner->segments[nextSegment].data(), owner->segments[nextSegment].size());
+}
+
+bool NaviUtilities::StringTemplate::Formatter::beginArgument() const
+{
+	return nextSegment < owner->segments.size();
+}
+
+void NaviUtilities::StringTemplate::Formatter::endArgument()
+{
+	output->append(owner->segments[nextSegment].data(), owner->segments[nextSegment].size());
+	nextSegment++;
+}
+
+NaviUtilities::StringTemplate::Formatter& NaviUtilities::StringTemplate::Formatter::operator()(const std::string& value)
+{
+	if(beginArgument())
+	{
+		output->append(value);
+		endArgument();
+	}
+
+	return *this;
+}
+
+NaviUtilities::StringTemplate::Formatter& NaviUtilities::StringTemplate::Formatter::operator()(const char* value)
+{
+	if(beginArgument())
+	{
+		output->append(value);
+		endArgument();
+	}
+
+	return *this;
+}
+
+NaviUtilities::StringTemplate::Formatter& NaviUtilities::StringTemplate::Formatter::operator()(const std::wstring& value)
+{
+	if(beginArgument())
+	{
+		appendMultibyte(*output, value);
+		endArgument();
+	}
+
+	return *this;
+}
+
+NaviUtilities::StringTemplate::Formatter& NaviUtilities::StringTemplate::Formatter::operator()(const MultiValue& value)
+{
+	if(beginArgument())
+	{
+		value.appendTo(*output);
+		endArgument();
+	}
+
+	return *this;
+}
+bool NaviUtilities::hexStringToRGB(const std::string& hexString, unsigned char &R, unsigned char &G, unsigned char &B)
+{
+	if(hexString.length() == 7)
+	{
+		if(hexString.find("#") == 0 && hexString.substr(1).find_first_not_of("0123456789ABCDEFabcdef") == std::string::npos)
+		{
+			R = static_cast<unsigned char>(strtoul(hexString.substr(1, 2).c_str(), 0, 16));
+			G = static_cast<unsigned char>(strtoul(hexString.substr(3, 2).c_str(), 0, 16));
+			B = static_cast<unsigned char>(strtoul(hexString.substr(5, 2).c_str(), 0, 16));
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+namespace
+{
+	const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	/**
+	* Lookup tables for Base64: 'pairs' maps every 12-bit value to its two output characters so that
+	* three input bytes are encoded with two lookups, 'values' maps a character back to its 6-bit value
+	* (or 0xFF if it isn't part of the alphabet).
+	*/
+	struct Base64Tables
+	{
+		char pairs[4096 * 2];
+		unsigned char values[256];
+
+		Base64Tables()
+		{
+			for(int i = 0; i < 4096; i++)
+			{
+				pairs[i * 2] = base64Chars[i >> 6];
+				pairs[i * 2 + 1] = base64Chars[i & 0x3F];
+			}
+
+			memset(values, 0xFF, sizeof(values));
+
+			for(int i = 0; i < 64; i++)
+				values[(unsigned char)base64Chars[i]] = (unsigned char)i;
+		}
+	} base64Tables;
+}
+
+size_t NaviUtilities::getBase64EncodedLength(size_t length)
+{
+	return (length + 2) / 3 * 4;
+}
+
+size_t NaviUtilities::encodeBase64(const unsigned char* src, size_t length, char* dest)
+{
+	const char* pairs = base64Tables.pairs;
+	const unsigned char* end = src + length - length % 3;
+	char* out = dest;
+
+	for(; src != end; src += 3, out += 4)
+	{
+		unsigned int triple = (src[0] << 16) | (src[1] << 8) | src[2];
+		memcpy(out, pairs + (triple >> 12) * 2, 2);
+		memcpy(out + 2, pairs + (triple & 0xFFF) * 2, 2);
+	}
+
+	switch(length % 3)
+	{
+	case 1:
+		out[0] = base64Chars[src[0] >> 2];
+		out[1] = base64Chars[(src[0] & 0x03) << 4];
+		out[2] = '=';
+		out[3] = '=';
+		out += 4;
+		break;
+	case 2:
+		out[0] = base64Chars[src[0] >> 2];
+		out[1] = base64Chars[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+		out[2] = base64Chars[(src[1] & 0x0F) << 2];
+		out[3] = '=';
+		out += 4;
+		break;
+	}
+
+	return out - dest;
+}
+
+std::string NaviUtilities::encodeBase64(const std::string &strToEncode)
+{
+	std::string result;
+	result.resize(getBase64EncodedLength(strToEncode.length()));
+
+	if(!result.empty())
+		encodeBase64(reinterpret_cast<const unsigned char*>(strToEncode.data()), strToEncode.length(), &result[0]);
+
+	return result;
+}
+
+size_t NaviUtilities::getBase64DecodedLength(size_t length)
+{
+	return length / 4 * 3 + (length % 4) * 3 / 4;
+}
+
+bool NaviUtilities::decodeBase64(const char* src, size_t length, unsigned char* dest, size_t &decodedLength)
+{
+	const unsigned char* values = base64Tables.values;
+	const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+
+	decodedLength = 0;
+
+	if(length % 4 == 0 && length)
+	{
+		if(in[length - 1] == '=')
+			length--;
+		if(in[length - 1] == '=')
+			length--;
+	}
+
+	if(length % 4 == 1)
+		return false;
+
+	const unsigned char* end = in + length - length % 4;
+	unsigned char* out = dest;
+
+	for(; in != end; in += 4, out += 3)
+	{
+		unsigned int a = values[in[0]], b = values[in[1]], c = values[in[2]], d = values[in[3]];
+
+		if((a | b | c | d) & 0xC0)
+			return false;
+
+		unsigned int triple = (a << 18) | (b << 12) | (c << 6) | d;
+		out[0] = (unsigned char)(triple >> 16);
+		out[1] = (unsigned char)(triple >> 8);
+		out[2] = (unsigned char)triple;
+	}
+
+	if(length % 4)
+	{
+		unsigned int a = values[in[0]], b = values[in[1]], c = length % 4 == 3 ? values[in[2]] : 0;
+
+		if((a | b | c) & 0xC0)
+			return false;
+
+		*out++ = (unsigned char)((a << 2) | (b >> 4));
+
+		if(length % 4 == 3)
+			*out++ = (unsigned char)((b << 4) | (c >> 2));
+	}
+
+	decodedLength = out - dest;
+	return true;
+}
+
+bool NaviUtilities::decodeBase64(const std::string &strToDecode, std::string &result)
+{
+	size_t decodedLength = 0;
+	// One spare byte so that there is always a buffer to pass, even for input that is too short to decode
+	result.resize(getBase64DecodedLength(strToDecode.length()) + 1);
+
+	if(!decodeBase64(strToDecode.data(), strToDecode.length(), reinterpret_cast<unsigned char*>(&result[0]), decodedLength))
+	{
+		result.clear();
+		return false;
+	}
+
+	result.resize(decodedLength);
+	return true;
+}
+
+namespace
+{
+	inline unsigned char average(unsigned char a, unsigned char b)
+	{
+		return (unsigned char)((a + b + 1) >> 1);
+	}
+
+	inline unsigned char multiply(unsigned char a, unsigned char b)
+	{
+		unsigned int t = a * b + 128;
+		return (unsigned char)((t + (t >> 8)) >> 8);
+	}
+
+	/**
+	* 16.16 fixed-point reciprocals of every alpha value (scaled by 255), so that un-premultiplying needs no division.
+	*/
+	struct ReciprocalTable
+	{
+		int values[256];
+
+		ReciprocalTable()
+		{
+			values[0] = 0;
+			for(int a = 1; a < 256; a++)
+				values[a] = (255 * 65536 + a / 2) / a;
+		}
+	};
+
+	// Built during static initialization, like cpuFeatures
+	const ReciprocalTable alphaReciprocals;
+
+	// Each SIMD kernel below converts as many whole blocks as it can, starting at pixel 'i', and returns the
+	// index of the first pixel it didn't convert: the next narrower path (and finally plain C++) does the rest.
+
+#ifdef NAVI_USE_SSSE3
+	size_t packBGRAtoBGR_SSSE3(const unsigned char* src, unsigned char* dest, size_t i, size_t count)
+	{
+		// Moves the three color bytes of each pixel to the bottom twelve bytes, the top four are zeroed
+		const __m128i packMask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		for(; i + 16 <= count; i += 16)
+		{
+			__m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 4)), packMask);
+			__m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 4 + 16)), packMask);
+			__m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 4 + 32)), packMask);
+			__m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 4 + 48)), packMask);
+
+			_mm_storeu_si128((__m128i*)(dest + i * 3), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+			_mm_storeu_si128((__m128i*)(dest + i * 3 + 16), _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+			_mm_storeu_si128((__m128i*)(dest + i * 3 + 32), _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+		}
+
+		return i;
+	}
+
+	size_t expandBGRtoBGRA_SSSE3(const unsigned char* src, unsigned char* dest, size_t i, size_t count, unsigned char alpha)
+	{
+		const __m128i expandMask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alphaBits = _mm_set1_epi32((int)((unsigned int)alpha << 24));
+
+		for(; i + 16 <= count; i += 16)
+		{
+			__m128i in0 = _mm_loadu_si128((const __m128i*)(src + i * 3));
+			__m128i in1 = _mm_loadu_si128((const __m128i*)(src + i * 3 + 16));
+			__m128i in2 = _mm_loadu_si128((const __m128i*)(src + i * 3 + 32));
+
+			_mm_storeu_si128((__m128i*)(dest + i * 4), _mm_or_si128(_mm_shuffle_epi8(in0, expandMask), alphaBits));
+			_mm_storeu_si128((__m128i*)(dest + i * 4 + 16), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), expandMask), alphaBits));
+			_mm_storeu_si128((__m128i*)(dest + i * 4 + 32), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), expandMask), alphaBits));
+			_mm_storeu_si128((__m128i*)(dest + i * 4 + 48), _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(in2, 4), expandMask), alphaBits));
+		}
+
+		return i;
+	}
+#endif
+
+#ifdef NAVI_USE_AVX2
+	size_t packBGRAtoBGR_AVX2(const unsigned char* src, unsigned char* dest, size_t i, size_t count)
+	{
+		// The byte shuffle works within each 128-bit lane, the dword permute then closes the gap between the lanes
+		const __m256i packMask = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		const __m256i joinLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+		for(; i + 8 <= count; i += 8)
+		{
+			__m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i * 4)), packMask), joinLanes);
+
+			_mm_storeu_si128((__m128i*)(dest + i * 3), _mm256_castsi256_si128(packed));
+			_mm_storel_epi64((__m128i*)(dest + i * 3 + 16), _mm256_extracti128_si256(packed, 1));
+		}
+
+		return i;
+	}
+
+	size_t premultiplyBGRA_AVX2(unsigned char* pixels, size_t i, size_t count)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i alphaLanes = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+		const __m256i alphaScale = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+		const __m256i rounding = _mm256_set1_epi16(128);
+
+		// Same as the SSE2 path, eight pixels at a time (unpacking and packing both stay within 128-bit lanes)
+		for(; i + 8 <= count; i += 8)
+		{
+			__m256i px = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+			__m256i lo = _mm256_unpacklo_epi8(px, zero);
+			__m256i hi = _mm256_unpackhi_epi8(px, zero);
+
+			__m256i alphaLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m256i alphaHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			alphaLo = _mm256_or_si256(_mm256_andnot_si256(alphaLanes, alphaLo), alphaScale);
+			alphaHi = _mm256_or_si256(_mm256_andnot_si256(alphaLanes, alphaHi), alphaScale);
+
+			lo = _mm256_add_epi16(_mm256_mullo_epi16(lo, alphaLo), rounding);
+			hi = _mm256_add_epi16(_mm256_mullo_epi16(hi, alphaHi), rounding);
+			lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+			hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+			_mm256_storeu_si256((__m256i*)(pixels + i * 4), _mm256_packus_epi16(lo, hi));
+		}
+
+		return i;
+	}
+
+	size_t unpremultiplyBGRA_AVX2(unsigned char* pixels, size_t i, size_t count)
+	{
+		const __m256i byteMask = _mm256_set1_epi32(0xFF);
+		const __m256i rounding = _mm256_set1_epi32(32768);
+		const __m256i maxChannel = _mm256_set1_epi32(255);
+
+		// Eight pixels at a time, one per 32-bit lane; the reciprocals are gathered from the same table as below
+		for(; i + 8 <= count; i += 8)
+		{
+			__m256i px = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+			__m256i alpha = _mm256_srli_epi32(px, 24);
+			__m256i reciprocal = _mm256_i32gather_epi32(alphaReciprocals.values, alpha, 4);
+
+			__m256i b = _mm256_and_si256(px, byteMask);
+			__m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), byteMask);
+			__m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 16), byteMask);
+
+			b = _mm256_min_epi32(_mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(b, reciprocal), rounding), 16), maxChannel);
+			g = _mm256_min_epi32(_mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(g, reciprocal), rounding), 16), maxChannel);
+			r = _mm256_min_epi32(_mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, reciprocal), rounding), 16), maxChannel);
+
+			__m256i result = _mm256_or_si256(_mm256_or_si256(b, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(alpha, 24)));
+			_mm256_storeu_si256((__m256i*)(pixels + i * 4), result);
+		}
+
+		return i;
+	}
+#endif
+}
+
+void NaviUtilities::downsampleBGRA(const unsigned char* src, size_t srcWidth, size_t srcHeight,
+								   unsigned char* dest, size_t destWidth, size_t left, size_t top, size_t right, size_t bottom)
+{
+	if(!srcWidth || !srcHeight)
+		return;
+
+	size_t srcPitch = srcWidth * 4;
+	size_t destPitch = destWidth * 4;
+
+#if OGRE_CPU == OGRE_CPU_X86
+	bool useSSE2 = hasSSE2();
+#endif
+
+	for(size_t y = top; y < bottom; y++)
+	{
+		const unsigned char* rowA = src + std::min(y * 2, srcHeight - 1) * srcPitch;
+		const unsigned char* rowB = src + std::min(y * 2 + 1, srcHeight - 1) * srcPitch;
+		unsigned char* destRow = dest + y * destPitch;
+		size_t x = left;
+
+#if OGRE_CPU == OGRE_CPU_X86
+		if(useSSE2)
+		{
+			// Four destination pixels per iteration: average the two source rows, then the even/odd columns
+			for(; x + 4 <= right && (x + 4) * 2 <= srcWidth; x += 4)
+			{
+				__m128i a0 = _mm_loadu_si128((const __m128i*)(rowA + x * 8));
+				__m128i a1 = _mm_loadu_si128((const __m128i*)(rowA + x * 8 + 16));
+				__m128i b0 = _mm_loadu_si128((const __m128i*)(rowB + x * 8));
+				__m128i b1 = _mm_loadu_si128((const __m128i*)(rowB + x * 8 + 16));
+
+				__m128 v0 = _mm_castsi128_ps(_mm_avg_epu8(a0, b0));
+				__m128 v1 = _mm_castsi128_ps(_mm_avg_epu8(a1, b1));
+
+				__m128i even = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+				__m128i odd = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+				_mm_storeu_si128((__m128i*)(destRow + x * 4), _mm_avg_epu8(even, odd));
+			}
+		}
+#endif
+
+		for(; x < right; x++)
+		{
+			size_t colA = std::min(x * 2, srcWidth - 1) * 4;
+			size_t colB = std::min(x * 2 + 1, srcWidth - 1) * 4;
+
+			for(size_t c = 0; c < 4; c++)
+				destRow[x * 4 + c] = average(average(rowA[colA + c], rowB[colA + c]), average(rowA[colB + c], rowB[colB + c]));
+		}
+	}
+}
+
+void NaviUtilities::scaleBGRA(const unsigned char* src, size_t srcWidth, size_t srcHeight, size_t srcPitch,
+	unsigned char* dest, size_t destWidth, size_t destHeight)
+{
+	// Halving never reaches a zero-sized destination, and there is nothing to sample in an empty source
+	if(!srcWidth || !srcHeight || !destWidth || !destHeight)
+		return;
+
+	std::vector<unsigned char> buffers[2];
+	int current = 0;
+
+	while(srcWidth / 2 >= destWidth && srcHeight / 2 >= destHeight)
+	{
+		// downsampleBGRA wants tightly packed rows
+		if(srcPitch != srcWidth * 4)
+		{
+			buffers[current].resize(srcWidth * srcHeight * 4);
+			for(size_t row = 0; row < srcHeight; row++)
+				memcpy(&buffers[current][row * srcWidth * 4], src + row * srcPitch, srcWidth * 4);
+
+			src = &buffers[current][0];
+			srcPitch = srcWidth * 4;
+			current = 1 - current;
+		}
+
+		size_t width = srcWidth / 2;
+		size_t height = srcHeight / 2;
+
+		buffers[current].resize(width * height * 4);
+		downsampleBGRA(src, srcWidth, srcHeight, &buffers[current][0], width, 0, 0, width, height);
+
+		src = &buffers[current][0];
+		srcWidth = width;
+		srcHeight = height;
+		srcPitch = width * 4;
+		current = 1 - current;
+	}
+
+	Ogre::PixelBox srcBox(srcWidth, srcHeight, 1, Ogre::PF_BYTE_BGRA, (void*)src);
+	srcBox.rowPitch = srcPitch / 4;
+	srcBox.slicePitch = srcBox.rowPitch * srcHeight;
+
+	Ogre::PixelBox destBox(destWidth, destHeight, 1, Ogre::PF_BYTE_BGRA, dest);
+
+	Ogre::Image::scale(srcBox, destBox, Ogre::Image::FILTER_BILINEAR);
+}
+
+void NaviUtilities::packBGRAtoBGR(const unsigned char* src, unsigned char* dest, size_t count)
+{
+	size_t i = 0;
+
+#if OGRE_CPU == OGRE_CPU_X86
+#ifdef NAVI_USE_AVX2
+	if(hasAVX2())
+		i = packBGRAtoBGR_AVX2(src, dest, i, count);
+#endif
+#ifdef NAVI_USE_SSSE3
+	if(hasSSSE3())
+		i = packBGRAtoBGR_SSSE3(src, dest, i, count);
+#endif
+
+	// Four pixels per iteration, shifted together in 32-bit words (SSE2 lacks a byte shuffle, this is faster)
+	for(; i + 4 <= count; i += 4)
+	{
+		const unsigned int* in = (const unsigned int*)(src + i * 4);
+		unsigned int* out = (unsigned int*)(dest + i * 3);
+
+		out[0] = (in[0] & 0x00FFFFFF) | (in[1] << 24);
+		out[1] = ((in[1] >> 8) & 0x0000FFFF) | (in[2] << 16);
+		out[2] = ((in[2] >> 16) & 0x000000FF) | (in[3] << 8);
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		dest[i * 3] = src[i * 4];
+		dest[i * 3 + 1] = src[i * 4 + 1];
+		dest[i * 3 + 2] = src[i * 4 + 2];
+	}
+}
+
+void NaviUtilities::expandBGRtoBGRA(const unsigned char* src, unsigned char* dest, size_t count, unsigned char alpha)
+{
+	size_t i = 0;
+
+#if OGRE_CPU == OGRE_CPU_X86
+#ifdef NAVI_USE_SSSE3
+	if(hasSSSE3())
+		i = expandBGRtoBGRA_SSSE3(src, dest, i, count, alpha);
+#endif
+
+	unsigned int alphaBits = (unsigned int)alpha << 24;
+
+	// Four pixels per iteration, shifted apart in 32-bit words
+	for(; i + 4 <= count; i += 4)
+	{
+		const unsigned int* in = (const unsigned int*)(src + i * 3);
+		unsigned int* out = (unsigned int*)(dest + i * 4);
+
+		out[0] = (in[0] & 0x00FFFFFF) | alphaBits;
+		out[1] = (in[0] >> 24) | ((in[1] & 0x0000FFFF) << 8) | alphaBits;
+		out[2] = (in[1] >> 16) | ((in[2] & 0x000000FF) << 16) | alphaBits;
+		out[3] = (in[2] >> 8) | alphaBits;
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		dest[i * 4] = src[i * 3];
+		dest[i * 4 + 1] = src[i * 3 + 1];
+		dest[i * 4 + 2] = src[i * 3 + 2];
+		dest[i * 4 + 3] = alpha;
+	}
+}
+
+void NaviUtilities::premultiplyBGRA(unsigned char* pixels, size_t count)
+{
+	size_t i = 0;
+
+#if OGRE_CPU == OGRE_CPU_X86
+#ifdef NAVI_USE_AVX2
+	if(hasAVX2())
+		i = premultiplyBGRA_AVX2(pixels, i, count);
+#endif
+
+	if(hasSSE2())
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		const __m128i alphaScale = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+		const __m128i rounding = _mm_set1_epi16(128);
+
+		// Four pixels per iteration, two per register in 16-bit lanes; alpha is multiplied by 255 to leave it unchanged
+		for(; i + 4 <= count; i += 4)
+		{
+			__m128i px = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+			__m128i lo = _mm_unpacklo_epi8(px, zero);
+			__m128i hi = _mm_unpackhi_epi8(px, zero);
+
+			__m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			alphaLo = _mm_or_si128(_mm_andnot_si128(alphaLanes, alphaLo), alphaScale);
+			alphaHi = _mm_or_si128(_mm_andnot_si128(alphaLanes, alphaHi), alphaScale);
+
+			lo = _mm_add_epi16(_mm_mullo_epi16(lo, alphaLo), rounding);
+			hi = _mm_add_epi16(_mm_mullo_epi16(hi, alphaHi), rounding);
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+			_mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_packus_epi16(lo, hi));
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		unsigned char* px = pixels + i * 4;
+		px[0] = multiply(px[0], px[3]);
+		px[1] = multiply(px[1], px[3]);
+		px[2] = multiply(px[2], px[3]);
+	}
+}
+
+void NaviUtilities::unpremultiplyBGRA(unsigned char* pixels, size_t count)
+{
+	size_t i = 0;
+
+#if OGRE_CPU == OGRE_CPU_X86 && defined(NAVI_USE_AVX2)
+	if(hasAVX2())
+		i = unpremultiplyBGRA_AVX2(pixels, i, count);
+#endif
+
+	for(; i < count; i++)
+	{
+		unsigned char* px = pixels + i * 4;
+
+		if(px[3] == 255)
+			continue;
+
+		unsigned int reciprocal = alphaReciprocals.values[px[3]];
+		px[0] = (unsigned char)std::min<unsigned int>((px[0] * reciprocal + 32768) >> 16, 255);
+		px[1] = (unsigned char)std::min<unsigned int>((px[1] * reciprocal + 32768) >> 16, 255);
+		px[2] = (unsigned char)std::min<unsigned int>((px[2] * reciprocal + 32768) >> 16, 255);
+	}
+}
+
+void NaviUtilities::extractAlpha(const unsigned char* src, unsigned char* dest, size_t count)
+{
+	size_t i = 0;
+
+#if OGRE_CPU == OGRE_CPU_X86
+	if(hasSSE2())
+	{
+		// Sixteen pixels per iteration: shift alpha down to the bottom of each pixel, then narrow twice
+		for(; i + 16 <= count; i += 16)
+		{
+			__m128i a0 = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(src + i * 4)), 24);
+			__m128i a1 = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(src + i * 4 + 16)), 24);
+			__m128i a2 = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(src + i * 4 + 32)), 24);
+			__m128i a3 = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(src + i * 4 + 48)), 24);
+
+			_mm_storeu_si128((__m128i*)(dest + i), _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3)));
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+		dest[i] = src[i * 4 + 3];
 }
\ No newline at end of file
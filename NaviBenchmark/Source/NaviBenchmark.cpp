@@ -0,0 +1,978 @@
+/*
+	NaviBenchmark times the kernels in NaviUtilities against plain C++ reference implementations (for most
+	kernels, the implementation NaviLibrary v1.8 shipped with) and checks that both produce the same result.
+
+	Run it without arguments to time every group, or pass the names of the groups to time:
+
+		NaviBenchmark base64 scale
+
+	Build it in one of the Release configurations, Debug builds say nothing about performance.
+*/
+
+#include "NaviUtilities.h"
+#include <OgreImage.h>
+#include <OgreTimer.h>
+#include <utf8.h>
+#include <algorithm>
+#include <ctype.h>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace NaviLibrary;
+using namespace NaviLibrary::NaviUtilities;
+
+namespace
+{
+	typedef void (*Kernel)(void* context);
+
+	Ogre::Timer timer;
+	bool allMatched = true;
+
+	/**
+	* Times a kernel: the number of calls is doubled until they take at least 20 ms, the fastest of five such
+	* runs is kept.
+	*
+	* @return	The time of a single call, in microseconds.
+	*/
+	double measure(Kernel kernel, void* context)
+	{
+		unsigned long iterations = 1;
+
+		for(;;)
+		{
+			unsigned long start = timer.getMicroseconds();
+			for(unsigned long i = 0; i < iterations; i++)
+				kernel(context);
+
+			if(timer.getMicroseconds() - start >= 20000)
+				break;
+
+			iterations *= 2;
+		}
+
+		double best = 0;
+
+		for(int run = 0; run < 5; run++)
+		{
+			unsigned long start = timer.getMicroseconds();
+			for(unsigned long i = 0; i < iterations; i++)
+				kernel(context);
+
+			double time = (double)(timer.getMicroseconds() - start) / iterations;
+			if(!run || time < best)
+				best = time;
+		}
+
+		return best;
+	}
+
+	void printGroup(const char* title)
+	{
+		printf("\n%s\n%-30s %12s %14s %14s %9s %12s\n", title, "kernel", "size", "reference us", "Navi us", "speedup", "MB/s");
+	}
+
+	/**
+	* Prints one line of results. 'bytes' is the amount of input processed per call, used for the throughput of
+	* the NaviUtilities implementation.
+	*/
+	void report(const char* name, const std::string& size, double referenceTime, double time, double bytes, bool matched)
+	{
+		printf("%-30s %12s %14.2f %14.2f %8.2fx %12.1f%s\n", name, size.c_str(), referenceTime, time,
+			referenceTime / time, bytes / time, matched ? "" : "  MISMATCH");
+
+		if(!matched)
+			allMatched = false;
+	}
+
+	std::string formatSize(size_t bytes)
+	{
+		if(bytes >= 1048576 && bytes % 1048576 == 0)
+			return numberToString(bytes / 1048576) + " MB";
+		if(bytes >= 1024 && bytes % 1024 == 0)
+			return numberToString(bytes / 1024) + " KB";
+
+		return numberToString(bytes) + " B";
+	}
+
+	void fillRandom(std::vector<unsigned char>& buffer)
+	{
+		srand(1234);
+		for(size_t i = 0; i < buffer.size(); i++)
+			buffer[i] = (unsigned char)(rand() & 0xFF);
+	}
+
+	/**
+	* The sizes of the images that Base64 and the scaling kernels are timed with, in bytes: from an icon to a
+	* full-screen BGRA page.
+	*/
+	const size_t imageSizes[] = { 65536, 262144, 1048576, 4194304, 8388608 };
+
+	bool shouldRun(int argc, char** argv, const char* group)
+	{
+		if(argc < 2)
+			return true;
+
+		for(int i = 1; i < argc; i++)
+			if(!strcmp(argv[i], group))
+				return true;
+
+		return false;
+	}
+
+	// Pixel conversions -----------------------------------------------------------------------------------------
+
+	typedef void (*RowConversion)(const unsigned char* src, unsigned char* dest, size_t count);
+
+	void referencePack(const unsigned char* src, unsigned char* dest, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			dest[i * 3] = src[i * 4];
+			dest[i * 3 + 1] = src[i * 4 + 1];
+			dest[i * 3 + 2] = src[i * 4 + 2];
+		}
+	}
+
+	void referenceExpand(const unsigned char* src, unsigned char* dest, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			dest[i * 4] = src[i * 3];
+			dest[i * 4 + 1] = src[i * 3 + 1];
+			dest[i * 4 + 2] = src[i * 3 + 2];
+			dest[i * 4 + 3] = 255;
+		}
+	}
+
+	void referencePremultiply(const unsigned char*, unsigned char* pixels, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			for(int c = 0; c < 3; c++)
+				pixels[i * 4 + c] = (unsigned char)((pixels[i * 4 + c] * pixels[i * 4 + 3] + 127) / 255);
+	}
+
+	void referenceUnpremultiply(const unsigned char*, unsigned char* pixels, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			unsigned int alpha = pixels[i * 4 + 3];
+
+			for(int c = 0; c < 3; c++)
+				pixels[i * 4 + c] = alpha ? (unsigned char)std::min<unsigned int>((pixels[i * 4 + c] * 255 + alpha / 2) / alpha, 255) : 0;
+		}
+	}
+
+	void referenceExtractAlpha(const unsigned char* src, unsigned char* dest, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			dest[i] = src[i * 4 + 3];
+	}
+
+	void naviPack(const unsigned char* src, unsigned char* dest, size_t count)
+	{
+		packBGRAtoBGR(src, dest, count);
+	}
+
+	void naviExpand(const unsigned char* src, unsigned char* dest, size_t count)
+	{
+		expandBGRtoBGRA(src, dest, count);
+	}
+
+	void naviPremultiply(const unsigned char*, unsigned char* pixels, size_t count)
+	{
+		premultiplyBGRA(pixels, count);
+	}
+
+	void naviUnpremultiply(const unsigned char*, unsigned char* pixels, size_t count)
+	{
+		unpremultiplyBGRA(pixels, count);
+	}
+
+	void naviExtractAlpha(const unsigned char* src, unsigned char* dest, size_t count)
+	{
+		extractAlpha(src, dest, count);
+	}
+
+	struct PixelKernel
+	{
+		const char* name;
+		size_t srcDepth;
+		size_t destDepth;
+		bool inPlace;
+		int tolerance;
+		RowConversion reference;
+		RowConversion navi;
+	};
+
+	const PixelKernel pixelKernels[] =
+	{
+		{ "packBGRAtoBGR", 4, 3, false, 0, referencePack, naviPack },
+		{ "expandBGRtoBGRA", 3, 4, false, 0, referenceExpand, naviExpand },
+		{ "premultiplyBGRA", 4, 4, true, 0, referencePremultiply, naviPremultiply },
+		// The reference divides exactly, unpremultiplyBGRA uses rounded fixed-point reciprocals
+		{ "unpremultiplyBGRA", 4, 4, true, 1, referenceUnpremultiply, naviUnpremultiply },
+		{ "extractAlpha", 4, 1, false, 0, referenceExtractAlpha, naviExtractAlpha }
+	};
+
+	const size_t pixelRows = 64;
+
+	struct PixelJob
+	{
+		RowConversion conversion;
+		const PixelKernel* kernel;
+		size_t width;
+		std::vector<unsigned char> src;
+		std::vector<unsigned char> dest;
+	};
+
+	void convertRows(void* context)
+	{
+		PixelJob& job = *static_cast<PixelJob*>(context);
+
+		for(size_t row = 0; row < pixelRows; row++)
+			job.conversion(&job.src[row * job.width * job.kernel->srcDepth], &job.dest[row * job.width * job.kernel->destDepth], job.width);
+	}
+
+	bool withinTolerance(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance)
+	{
+		for(size_t i = 0; i < a.size(); i++)
+			if(abs((int)a[i] - (int)b[i]) > tolerance)
+				return false;
+
+		return true;
+	}
+
+	void benchmarkPixelConversions()
+	{
+		printGroup("Pixel conversions (64 rows of the given width)");
+
+		const size_t widths[] = { 256, 512, 800, 1024, 1280, 1920 };
+
+		for(size_t k = 0; k < sizeof(pixelKernels) / sizeof(pixelKernels[0]); k++)
+		{
+			const PixelKernel& kernel = pixelKernels[k];
+
+			for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+			{
+				PixelJob job;
+				job.kernel = &kernel;
+				job.width = widths[w];
+				job.src.resize(job.width * pixelRows * kernel.srcDepth);
+				job.dest.resize(job.width * pixelRows * kernel.destDepth);
+				fillRandom(job.src);
+
+				// In-place kernels work on 'dest', start both from the same pixels
+				std::vector<unsigned char> expected;
+				job.dest = kernel.inPlace ? job.src : job.dest;
+				job.conversion = kernel.reference;
+				convertRows(&job);
+				expected.swap(job.dest);
+
+				job.dest = kernel.inPlace ? job.src : std::vector<unsigned char>(expected.size());
+				job.conversion = kernel.navi;
+				convertRows(&job);
+				bool matched = withinTolerance(job.dest, expected, kernel.tolerance);
+
+				job.conversion = kernel.reference;
+				double referenceTime = measure(convertRows, &job);
+				job.conversion = kernel.navi;
+				double time = measure(convertRows, &job);
+
+				report(kernel.name, numberToString(job.width) + " px", referenceTime, time, (double)job.src.size(), matched);
+			}
+		}
+	}
+
+	// MultiValue ------------------------------------------------------------------------------------------------
+
+	std::wstring referenceToWide(const std::string& str)
+	{
+		size_t size = mbstowcs(0, str.c_str(), 0) + 1;
+		wchar_t* temp = new wchar_t[size];
+		mbstowcs(temp, str.c_str(), size);
+		std::wstring result(temp);
+		delete[] temp;
+		return result;
+	}
+
+	std::string referenceToMultibyte(const std::wstring& str)
+	{
+		size_t size = wcstombs(0, str.c_str(), 0) + 1;
+		char* temp = new char[size];
+		wcstombs(temp, str.c_str(), size);
+		std::string result(temp);
+		delete[] temp;
+		return result;
+	}
+
+	template<class NumberType>
+	std::string referenceNumberToString(NumberType number)
+	{
+		std::ostringstream converter;
+
+		return (converter << std::setprecision(17) << number).fail() ? "" : converter.str();
+	}
+
+	/**
+	* MultiValue as v1.8 had it: every value was formatted and kept as a wide string.
+	*/
+	class ReferenceMultiValue
+	{
+		std::wstring value;
+
+	public:
+		template<class NumberType>
+		ReferenceMultiValue(NumberType number) : value(referenceToWide(referenceNumberToString(number))) { }
+
+		std::string str() const { return referenceToMultibyte(value); }
+	};
+
+	const size_t multiValueCount = 1000000;
+
+	template<class NumberType>
+	struct MultiValueJob
+	{
+		std::vector<NumberType> numbers;
+		size_t length;
+	};
+
+	/**
+	* Constructs a MultiValue (or a ReferenceMultiValue) from every number and formats it.
+	*/
+	template<class Value, class NumberType>
+	void formatValues(void* context)
+	{
+		MultiValueJob<NumberType>& job = *static_cast<MultiValueJob<NumberType>*>(context);
+
+		job.length = 0;
+		for(size_t i = 0; i < job.numbers.size(); i++)
+			job.length += Value(job.numbers[i]).str().length();
+	}
+
+	/**
+	* v1.8 wrote 17 significant digits, MultiValue now writes the fewest that parse back to the same number:
+	* compare the numbers parsed back rather than the text.
+	*/
+	template<class NumberType>
+	bool sameNumbers(const std::vector<NumberType>& numbers)
+	{
+		for(size_t i = 0; i < numbers.size(); i++)
+		{
+			std::string reference = ReferenceMultiValue(numbers[i]).str();
+			std::string navi = MultiValue(numbers[i]).str();
+
+			if((NumberType)strtod(reference.c_str(), 0) != numbers[i] || (NumberType)strtod(navi.c_str(), 0) != numbers[i])
+				return false;
+		}
+
+		return true;
+	}
+
+	template<class NumberType>
+	void benchmarkMultiValue(const char* name, MultiValueJob<NumberType>& job)
+	{
+		bool matched = sameNumbers(job.numbers);
+
+		double referenceTime = measure(formatValues<ReferenceMultiValue, NumberType>, &job);
+		double time = measure(formatValues<MultiValue, NumberType>, &job);
+
+		report(name, "1M values", referenceTime, time, (double)(job.numbers.size() * sizeof(NumberType)), matched);
+	}
+
+	void benchmarkMultiValues()
+	{
+		printGroup("MultiValue (construct and format, as str())");
+
+		srand(1234);
+
+		MultiValueJob<int> ints;
+		for(size_t i = 0; i < multiValueCount; i++)
+			ints.numbers.push_back((rand() % 65536 - 32768) * (rand() % 65536));
+
+		MultiValueJob<float> floats;
+		for(size_t i = 0; i < multiValueCount; i++)
+			floats.numbers.push_back((float)(rand() % 65536 - 32768) / (float)(rand() % 1000 + 1));
+
+		benchmarkMultiValue("MultiValue(int)", ints);
+		benchmarkMultiValue("MultiValue(float)", floats);
+	}
+
+	// String replacement ----------------------------------------------------------------------------------------
+
+	/**
+	* replaceAll as v1.8 had it: every match is erased and the replacement inserted in place.
+	*/
+	int referenceReplaceAll(std::string& sourceStr, const std::string& replaceWhat, const std::string& replaceWith)
+	{
+		int count = 0;
+
+		for(size_t i = sourceStr.find(replaceWhat); i != std::string::npos; i = sourceStr.find(replaceWhat, i + replaceWith.length()))
+		{
+			sourceStr.erase(i, replaceWhat.length());
+			sourceStr.insert(i, replaceWith);
+			++count;
+		}
+
+		return count;
+	}
+
+	const size_t replaceLength = 1048576;
+
+	struct ReplaceJob
+	{
+		std::string source;
+		std::string result;
+	};
+
+	const Replacer jsEscaper = Replacer("\\", "\\\\")("'", "\\'")("\n", "\\n")("\r", "\\r");
+
+	void referenceReplaceQuotes(void* context)
+	{
+		ReplaceJob& job = *static_cast<ReplaceJob*>(context);
+
+		job.result = job.source;
+		referenceReplaceAll(job.result, "'", "\\'");
+	}
+
+	void naviReplaceQuotes(void* context)
+	{
+		ReplaceJob& job = *static_cast<ReplaceJob*>(context);
+
+		job.result = job.source;
+		replaceAll(job.result, "'", "\\'");
+	}
+
+	// Escaping a Javascript string literal took one replaceAll per pattern, backslashes first
+	void referenceEscapeJS(void* context)
+	{
+		ReplaceJob& job = *static_cast<ReplaceJob*>(context);
+
+		job.result = job.source;
+		referenceReplaceAll(job.result, "\\", "\\\\");
+		referenceReplaceAll(job.result, "'", "\\'");
+		referenceReplaceAll(job.result, "\n", "\\n");
+		referenceReplaceAll(job.result, "\r", "\\r");
+	}
+
+	void naviEscapeJS(void* context)
+	{
+		ReplaceJob& job = *static_cast<ReplaceJob*>(context);
+
+		job.result = job.source;
+		jsEscaper.replaceAll(job.result);
+	}
+
+	void benchmarkReplace(const char* name, ReplaceJob& job, Kernel reference, Kernel navi)
+	{
+		reference(&job);
+		std::string expected = job.result;
+		navi(&job);
+		bool matched = job.result == expected;
+
+		double referenceTime = measure(reference, &job);
+		double time = measure(navi, &job);
+
+		report(name, formatSize(job.source.size()), referenceTime, time, (double)job.source.size(), matched);
+	}
+
+	void benchmarkStrings()
+	{
+		printGroup("String replacement (a Javascript payload, one escaped character in about 250)");
+
+		// Mostly plain text, the odd quote, backslash or line break
+		const char special[] = { '\'', '\\', '\n', '\r' };
+		ReplaceJob job;
+		srand(1234);
+		job.source.resize(replaceLength);
+		for(size_t i = 0; i < replaceLength; i++)
+			job.source[i] = rand() % 250 ? (char)('a' + rand() % 26) : special[rand() % 4];
+
+		benchmarkReplace("replaceAll", job, referenceReplaceQuotes, naviReplaceQuotes);
+		benchmarkReplace("Replacer (4 patterns)", job, referenceEscapeJS, naviEscapeJS);
+	}
+
+	// Base64 ----------------------------------------------------------------------------------------------------
+
+	const std::string referenceBase64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	/**
+	* encodeBase64 as v1.8 had it, freely-available code by René Nyffenegger
+	* (http://www.adp-gmbh.ch/cpp/common/base64.html)
+	*/
+	std::string referenceEncodeBase64(const std::string& strToEncode)
+	{
+		unsigned char const* bytes_to_encode = reinterpret_cast<const unsigned char*>(strToEncode.c_str());
+		unsigned int in_len = (unsigned int)strToEncode.length();
+		const std::string base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		std::string ret;
+		int i = 0;
+		int j = 0;
+		unsigned char char_array_3[3];
+		unsigned char char_array_4[4];
+
+		while(in_len--)
+		{
+			char_array_3[i++] = *(bytes_to_encode++);
+
+			if(i == 3)
+			{
+				char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+				char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+				char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+				char_array_4[3] = char_array_3[2] & 0x3f;
+
+				for(i = 0; i < 4; i++)
+					ret += base64_chars[char_array_4[i]];
+
+				i = 0;
+			}
+		}
+
+		if(i)
+		{
+			for(j = i; j < 3; j++)
+				char_array_3[j] = '\0';
+
+			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+			char_array_4[3] = char_array_3[2] & 0x3f;
+
+			for (j = 0; (j < i + 1); j++)
+				ret += base64_chars[char_array_4[j]];
+
+			while((i++ < 3))
+				ret += '=';
+		}
+
+		return ret;
+	}
+
+	/**
+	* v1.8 had no decoder, this is the one from the same source as its encoder.
+	*/
+	std::string referenceDecodeBase64(const std::string& encoded_string)
+	{
+		int in_len = (int)encoded_string.size();
+		int i = 0;
+		int j = 0;
+		int in_ = 0;
+		unsigned char char_array_4[4], char_array_3[3];
+		std::string ret;
+
+		while(in_len-- && (encoded_string[in_] != '=') && (isalnum((unsigned char)encoded_string[in_]) || (encoded_string[in_] == '+') || (encoded_string[in_] == '/')))
+		{
+			char_array_4[i++] = encoded_string[in_]; in_++;
+
+			if(i == 4)
+			{
+				for(i = 0; i < 4; i++)
+					char_array_4[i] = (unsigned char)referenceBase64Chars.find(char_array_4[i]);
+
+				char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
+				char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+				char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+
+				for(i = 0; (i < 3); i++)
+					ret += char_array_3[i];
+
+				i = 0;
+			}
+		}
+
+		if(i)
+		{
+			for(j = i; j < 4; j++)
+				char_array_4[j] = 0;
+
+			for(j = 0; j < 4; j++)
+				char_array_4[j] = (unsigned char)referenceBase64Chars.find(char_array_4[j]);
+
+			char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
+			char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+			char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+
+			for(j = 0; (j < i - 1); j++)
+				ret += char_array_3[j];
+		}
+
+		return ret;
+	}
+
+	struct Base64Job
+	{
+		std::string data;
+		std::string encoded;
+		std::string referenceResult;
+		std::vector<char> encodeBuffer;
+		std::vector<unsigned char> decodeBuffer;
+		size_t decodedLength;
+	};
+
+	void referenceEncode(void* context)
+	{
+		Base64Job& job = *static_cast<Base64Job*>(context);
+
+		job.referenceResult = referenceEncodeBase64(job.data);
+	}
+
+	// The caller-buffer overload, as used for data URIs
+	void naviEncode(void* context)
+	{
+		Base64Job& job = *static_cast<Base64Job*>(context);
+
+		encodeBase64((const unsigned char*)job.data.data(), job.data.size(), &job.encodeBuffer[0]);
+	}
+
+	void referenceDecode(void* context)
+	{
+		Base64Job& job = *static_cast<Base64Job*>(context);
+
+		job.referenceResult = referenceDecodeBase64(job.encoded);
+	}
+
+	void naviDecode(void* context)
+	{
+		Base64Job& job = *static_cast<Base64Job*>(context);
+
+		decodeBase64(job.encoded.data(), job.encoded.size(), &job.decodeBuffer[0], job.decodedLength);
+	}
+
+	void benchmarkBase64Size(size_t size)
+	{
+		Base64Job job;
+		std::vector<unsigned char> bytes(size);
+		fillRandom(bytes);
+		job.data.assign(bytes.begin(), bytes.end());
+		job.encodeBuffer.resize(getBase64EncodedLength(size));
+
+		referenceEncode(&job);
+		naviEncode(&job);
+		job.encoded = job.referenceResult;
+		bool matched = std::string(job.encodeBuffer.begin(), job.encodeBuffer.end()) == job.encoded;
+
+		double referenceTime = measure(referenceEncode, &job);
+		double time = measure(naviEncode, &job);
+		report("encodeBase64", formatSize(size), referenceTime, time, (double)size, matched);
+
+		job.decodeBuffer.resize(getBase64DecodedLength(job.encoded.size()));
+		referenceDecode(&job);
+		naviDecode(&job);
+		matched = job.referenceResult == job.data && job.decodedLength == size && !memcmp(&job.decodeBuffer[0], job.data.data(), size);
+
+		referenceTime = measure(referenceDecode, &job);
+		time = measure(naviDecode, &job);
+		report("decodeBase64", formatSize(size), referenceTime, time, (double)job.encoded.size(), matched);
+	}
+
+	void benchmarkBase64()
+	{
+		printGroup("Base64 (random bytes)");
+
+		for(size_t i = 0; i < sizeof(imageSizes) / sizeof(imageSizes[0]); i++)
+			benchmarkBase64Size(imageSizes[i]);
+	}
+	// UTF-8 -----------------------------------------------------------------------------------------------------
+
+	/**
+	* v1.8 converted with mbstowcs/wcstombs, which can't produce UTF-8 under the Microsoft C runtime at all; the
+	* reference is the straightforward use of the bundled utf8-cpp instead.
+	*/
+	void referenceUTF8ToWide(const std::string& source, std::wstring& result)
+	{
+		result.clear();
+
+		if(sizeof(wchar_t) == 2)
+			utf8::utf8to16(source.begin(), source.end(), std::back_inserter(result));
+		else
+			utf8::utf8to32(source.begin(), source.end(), std::back_inserter(result));
+	}
+
+	void referenceWideToUTF8(const std::wstring& source, std::string& result)
+	{
+		result.clear();
+
+		if(sizeof(wchar_t) == 2)
+			utf8::utf16to8(source.begin(), source.end(), std::back_inserter(result));
+		else
+			utf8::utf32to8(source.begin(), source.end(), std::back_inserter(result));
+	}
+
+	const size_t utf8Length = 1048576;
+
+	struct UTF8Job
+	{
+		std::string narrow;
+		std::wstring wide;
+		std::string narrowResult;
+		std::wstring wideResult;
+		bool valid;
+	};
+
+	void referenceDecodeUTF8(void* context)
+	{
+		UTF8Job& job = *static_cast<UTF8Job*>(context);
+
+		referenceUTF8ToWide(job.narrow, job.wideResult);
+	}
+
+	void naviDecodeUTF8(void* context)
+	{
+		UTF8Job& job = *static_cast<UTF8Job*>(context);
+
+		toWide(job.narrow, job.wideResult);
+	}
+
+	void referenceEncodeUTF8(void* context)
+	{
+		UTF8Job& job = *static_cast<UTF8Job*>(context);
+
+		referenceWideToUTF8(job.wide, job.narrowResult);
+	}
+
+	void naviEncodeUTF8(void* context)
+	{
+		UTF8Job& job = *static_cast<UTF8Job*>(context);
+
+		toMultibyte(job.wide, job.narrowResult);
+	}
+
+	void referenceValidateUTF8(void* context)
+	{
+		UTF8Job& job = *static_cast<UTF8Job*>(context);
+
+		job.valid = utf8::is_valid(job.narrow.begin(), job.narrow.end());
+	}
+
+	void naviValidateUTF8(void* context)
+	{
+		UTF8Job& job = *static_cast<UTF8Job*>(context);
+
+		job.valid = isValidUTF8(job.narrow);
+	}
+
+	/**
+	* Appends a code point as UTF-8; only used for the test text, which stays within the Basic Multilingual Plane.
+	*/
+	void appendCodePoint(std::string& dest, unsigned int codePoint)
+	{
+		if(codePoint < 0x80)
+			dest += (char)codePoint;
+		else if(codePoint < 0x800)
+		{
+			dest += (char)(0xC0 | (codePoint >> 6));
+			dest += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			dest += (char)(0xE0 | (codePoint >> 12));
+			dest += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			dest += (char)(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	void benchmarkUTF8Text(const char* text, UTF8Job& job)
+	{
+		std::string size = formatSize(utf8Length) + " " + text;
+		referenceUTF8ToWide(job.narrow, job.wide);
+
+		naviDecodeUTF8(&job);
+		bool matched = job.wideResult == job.wide;
+		double referenceTime = measure(referenceDecodeUTF8, &job);
+		double time = measure(naviDecodeUTF8, &job);
+		report("toWide", size, referenceTime, time, (double)job.narrow.size(), matched);
+
+		naviEncodeUTF8(&job);
+		matched = job.narrowResult == job.narrow;
+		referenceTime = measure(referenceEncodeUTF8, &job);
+		time = measure(naviEncodeUTF8, &job);
+		report("toMultibyte", size, referenceTime, time, (double)job.narrow.size(), matched);
+
+		naviValidateUTF8(&job);
+		matched = job.valid;
+		referenceTime = measure(referenceValidateUTF8, &job);
+		time = measure(naviValidateUTF8, &job);
+		report("isValidUTF8", size, referenceTime, time, (double)job.narrow.size(), matched);
+	}
+
+	void benchmarkUTF8()
+	{
+		printGroup("UTF-8 (MB/s of UTF-8)");
+
+		srand(1234);
+
+		// Markup and English text: all ASCII
+		UTF8Job ascii;
+		while(ascii.narrow.size() < utf8Length)
+			ascii.narrow += rand() % 8 ? (char)('a' + rand() % 26) : ' ';
+
+		// Chinese or Japanese text, the odd ASCII space or digit in between
+		UTF8Job cjk;
+		while(cjk.narrow.size() < utf8Length - 3)
+			appendCodePoint(cjk.narrow, rand() % 10 ? 0x4E00 + rand() % 0x5200 : (unsigned int)(rand() % 2 ? ' ' : '0' + rand() % 10));
+
+		benchmarkUTF8Text("ASCII", ascii);
+		benchmarkUTF8Text("CJK", cjk);
+	}
+	// Image scaling ---------------------------------------------------------------------------------------------
+
+	inline unsigned char referenceAverage(unsigned char a, unsigned char b)
+	{
+		return (unsigned char)((a + b + 1) >> 1);
+	}
+
+	void referenceDownsample(const unsigned char* src, size_t srcWidth, size_t srcHeight, unsigned char* dest, size_t destWidth, size_t destHeight)
+	{
+		for(size_t y = 0; y < destHeight; y++)
+		{
+			const unsigned char* rowA = src + std::min(y * 2, srcHeight - 1) * srcWidth * 4;
+			const unsigned char* rowB = src + std::min(y * 2 + 1, srcHeight - 1) * srcWidth * 4;
+
+			for(size_t x = 0; x < destWidth; x++)
+			{
+				size_t colA = std::min(x * 2, srcWidth - 1) * 4;
+				size_t colB = std::min(x * 2 + 1, srcWidth - 1) * 4;
+
+				for(size_t c = 0; c < 4; c++)
+					dest[(y * destWidth + x) * 4 + c] = referenceAverage(referenceAverage(rowA[colA + c], rowB[colA + c]),
+						referenceAverage(rowA[colB + c], rowB[colB + c]));
+			}
+		}
+	}
+
+	/**
+	* The same algorithm as scaleBGRA, one pixel at a time: halve while the image remains at least as large as
+	* the destination, then filter bilinearly.
+	*/
+	void referenceScale(const unsigned char* src, size_t srcWidth, size_t srcHeight, unsigned char* dest, size_t destWidth, size_t destHeight)
+	{
+		std::vector<unsigned char> image(src, src + srcWidth * srcHeight * 4);
+
+		while(srcWidth / 2 >= destWidth && srcHeight / 2 >= destHeight)
+		{
+			std::vector<unsigned char> half(srcWidth / 2 * (srcHeight / 2) * 4);
+			referenceDownsample(&image[0], srcWidth, srcHeight, &half[0], srcWidth / 2, srcHeight / 2);
+			image.swap(half);
+			srcWidth /= 2;
+			srcHeight /= 2;
+		}
+
+		Ogre::PixelBox srcBox(srcWidth, srcHeight, 1, Ogre::PF_BYTE_BGRA, &image[0]);
+		Ogre::PixelBox destBox(destWidth, destHeight, 1, Ogre::PF_BYTE_BGRA, dest);
+		Ogre::Image::scale(srcBox, destBox, Ogre::Image::FILTER_BILINEAR);
+	}
+
+	struct ScaleJob
+	{
+		std::vector<unsigned char> src;
+		std::vector<unsigned char> dest;
+		size_t width;
+		size_t height;
+		size_t destWidth;
+		size_t destHeight;
+	};
+
+	void referenceDownsampleJob(void* context)
+	{
+		ScaleJob& job = *static_cast<ScaleJob*>(context);
+
+		referenceDownsample(&job.src[0], job.width, job.height, &job.dest[0], job.width / 2, job.height / 2);
+	}
+
+	void naviDownsampleJob(void* context)
+	{
+		ScaleJob& job = *static_cast<ScaleJob*>(context);
+
+		downsampleBGRA(&job.src[0], job.width, job.height, &job.dest[0], job.width / 2, 0, 0, job.width / 2, job.height / 2);
+	}
+
+	void referenceScaleJob(void* context)
+	{
+		ScaleJob& job = *static_cast<ScaleJob*>(context);
+
+		referenceScale(&job.src[0], job.width, job.height, &job.dest[0], job.destWidth, job.destHeight);
+	}
+
+	void naviScaleJob(void* context)
+	{
+		ScaleJob& job = *static_cast<ScaleJob*>(context);
+
+		scaleBGRA(&job.src[0], job.width, job.height, job.width * 4, &job.dest[0], job.destWidth, job.destHeight);
+	}
+
+	bool compareJobs(ScaleJob& job, Kernel reference, Kernel navi)
+	{
+		reference(&job);
+		std::vector<unsigned char> expected = job.dest;
+		navi(&job);
+
+		return job.dest == expected;
+	}
+
+	void benchmarkScaling()
+	{
+		printGroup("Image scaling (BGRA)");
+
+		for(size_t i = 0; i < sizeof(imageSizes) / sizeof(imageSizes[0]); i++)
+		{
+			// Power-of-two widths, as wide as high or twice as wide
+			ScaleJob job;
+			size_t pixels = imageSizes[i] / 4;
+			job.width = 1;
+			while(job.width * job.width < pixels)
+				job.width *= 2;
+			job.height = pixels / job.width;
+			job.src.resize(imageSizes[i]);
+			fillRandom(job.src);
+
+			job.dest.resize(job.width / 2 * (job.height / 2) * 4);
+			bool matched = compareJobs(job, referenceDownsampleJob, naviDownsampleJob);
+			double referenceTime = measure(referenceDownsampleJob, &job);
+			double time = measure(naviDownsampleJob, &job);
+			report("downsampleBGRA (1/2)", formatSize(imageSizes[i]), referenceTime, time, (double)imageSizes[i], matched);
+
+			// A thumbnail: halved once or more, then bilinearly filtered
+			job.destWidth = job.width * 3 / 10;
+			job.destHeight = job.height * 3 / 10;
+			job.dest.resize(job.destWidth * job.destHeight * 4);
+			matched = compareJobs(job, referenceScaleJob, naviScaleJob);
+			referenceTime = measure(referenceScaleJob, &job);
+			time = measure(naviScaleJob, &job);
+			report("scaleBGRA (3/10)", formatSize(imageSizes[i]), referenceTime, time, (double)imageSizes[i], matched);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	printf("NaviBenchmark: the fastest of five runs, per call\n");
+
+	if(shouldRun(argc, argv, "pixels"))
+		benchmarkPixelConversions();
+
+	if(shouldRun(argc, argv, "multivalue"))
+		benchmarkMultiValues();
+
+	if(shouldRun(argc, argv, "strings"))
+		benchmarkStrings();
+
+	if(shouldRun(argc, argv, "base64"))
+		benchmarkBase64();
+
+	if(shouldRun(argc, argv, "utf8"))
+		benchmarkUTF8();
+
+	if(shouldRun(argc, argv, "scale"))
+		benchmarkScaling();
+
+	if(!allMatched)
+		printf("\nSome results didn't match their reference implementation!\n");
+
+	return allMatched ? 0 : 1;
+}
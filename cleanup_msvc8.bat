@@ -26,4 +26,7 @@
 @rmdir "NaviDemo\Bin\release dll\" /S /Q
 @rmdir "NaviDemo\Bin\debug dll\" /S /Q
 @del NaviDemo\Bin\Media\Navi.js
+@del NaviBenchmark\*.user
+@rmdir NaviBenchmark\Objects\ /S /Q
+@rmdir NaviBenchmark\Bin\ /S /Q
 @echo ============== Done! ===============